@@ -4,6 +4,6 @@ git submodule update --recursive
 
 mkdir -p build
 cd build
-cmake .. -DCMAKE_BUILD_TYPE=Release
+cmake .. -DCMAKE_BUILD_TYPE=Release "$@"
 make -j 4
 
@@ -0,0 +1,83 @@
+import rl
+from checks import check, check_same, report
+
+# checks bitmask operators against the same operators on arrays, including views
+# which start at offsets around word boundaries and overlap the bitmask they update
+
+OFFSETS = [0, 1, 31, 63, 64, 65]
+WIDTHS = [1, 63, 64, 65, 100]
+
+def random_bitmask(width, height):
+    a = rl.Array(width, height)
+    a.random_int(0, 1)
+    return rl.bitmask_from_array(a)
+
+def update(op, m, dest, src):
+    x, y, width, height = dest
+    view = m[x:x + width, y:y + height]
+    if op == '&':
+        view &= src
+    elif op == '|':
+        view |= src
+    elif op == '^':
+        view ^= src
+    else:
+        m[x:x + width, y:y + height] = src
+
+def expected_update(op, a, dest, src):
+    x, y, width, height = dest
+    if op == '&':
+        src = a[x:x + width, y:y + height] & src
+    elif op == '|':
+        src = a[x:x + width, y:y + height] | src
+    elif op == '^':
+        src = a[x:x + width, y:y + height] ^ src
+    result = a.copy()
+    src.copy_to(result[x:x + width, y:y + height])
+    return result
+
+def check_operators(width, height):
+    a, b = random_bitmask(width, height), random_bitmask(width, height)
+    aa, ba = a.to_array(), b.to_array()
+    check_same((a & b).to_array(), aa & ba, 'a & b')
+    check_same((a | b).to_array(), aa | ba, 'a | b')
+    check_same((a ^ b).to_array(), aa ^ ba, 'a ^ b')
+    check_same((~a).to_array(), aa.equals(0), '~a')
+    check(a.count() == aa.sum(), 'count')
+    check_same(a.copy().to_array(), aa, 'copy')
+    check_same(rl.bitmask_from_array(aa).to_array(), aa, 'from array')
+
+def check_views(width, height):
+    for x in OFFSETS:
+        for w in WIDTHS:
+            if x + w > width:
+                continue
+            a, b = random_bitmask(width, height), random_bitmask(width, height)
+            va, vb = a[x:x + w, 1:], b[width - w:, :-1]
+            name = 'views at %d and %d of width %d' % (x, width - w, w)
+            check_same((va & vb).to_array(), va.to_array() & vb.to_array(), name + ' &')
+            check_same((va | vb).to_array(), va.to_array() | vb.to_array(), name + ' |')
+            check_same((~va).to_array(), va.to_array().equals(0), name + ' ~')
+            check(va.count() == va.to_array().sum(), name + ' count')
+
+def check_overlapping_views(width, height):
+    for op in ['&', '|', '^', 'copy']:
+        for dest_x in OFFSETS:
+            for src_x in OFFSETS:
+                for w in WIDTHS:
+                    if max(dest_x, src_x) + w > width:
+                        continue
+                    for dest_y, src_y in [(0, 0), (1, 0), (0, 2)]:
+                        h = height - 2
+                        m = random_bitmask(width, height)
+                        a = m.to_array()
+                        dest = (dest_x, dest_y, w, h)
+                        expected = expected_update(op, a, dest, a[src_x:src_x + w, src_y:src_y + h])
+                        update(op, m, dest, m[src_x:src_x + w, src_y:src_y + h])
+                        check_same(m.to_array(), expected, '%s from (%d, %d) into (%d, %d) of width %d' % (op, src_x, src_y, dest_x, dest_y, w))
+
+for width, height in [(200, 6), (130, 3)]:
+    check_operators(width, height)
+    check_views(width, height)
+    check_overlapping_views(width, height)
+report()
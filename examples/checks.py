@@ -0,0 +1,38 @@
+import rl
+
+# helpers shared by the *_check.py scripts, run as `pyrogue examples/<name>_check.py`;
+# a failing check raises AssertionError, so pyrogue exits with a non-zero status
+
+passed = 0
+
+def check(condition, message):
+    global passed
+    if not condition:
+        raise AssertionError(message)
+    passed += 1
+
+# arrays or bitmasks of the same size
+def differs(a, b):
+    if isinstance(a, rl.Bitmask):
+        return (a ^ b).any()
+    return bool(a.not_equals(b))
+
+def check_same(result, expected, message):
+    check(not differs(result, expected), message)
+
+def check_raises(f, message):
+    try:
+        f()
+    except Exception:
+        check(True, message)
+        return
+    raise AssertionError(message + ' accepted')
+
+# 1 for walls, about one cell in chance
+def random_level(width, height, chance=3):
+    noise = rl.Array(width, height)
+    noise.random_int(0, chance - 1)
+    return noise.equals(0)
+
+def report():
+    print('ok:', passed, 'checks passed')
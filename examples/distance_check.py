@@ -0,0 +1,44 @@
+import rl
+from checks import check, check_same, report
+
+# checks the distance transform against the distance to every feature cell
+
+def features(a, value):
+    return [(x, y) for y in range(a.height()) for x in range(a.width()) if a[x, y] == value]
+
+def metric_distance(metric, dx, dy):
+    if metric == rl.DISTANCE_CHEBYSHEV:
+        return max(abs(dx), abs(dy))
+    if metric == rl.DISTANCE_MANHATTAN:
+        return abs(dx) + abs(dy)
+    return (dx * dx + dy * dy) ** 0.5
+
+def check_transform(width, height, chance):
+    level = rl.Array(width, height)
+    level.random_int(0, chance)
+    cells = features(level, 0)
+    for metric in [rl.DISTANCE_EUCLIDEAN, rl.DISTANCE_CHEBYSHEV, rl.DISTANCE_MANHATTAN]:
+        distances, nearest_x, nearest_y = level.distance_transform(0, metric=metric, nearest=True)
+        check_same(level.distance_transform(0, metric=metric), distances, 'metric %d without nearest' % metric)
+        for y in range(height):
+            for x in range(width):
+                name = 'metric %d at %s' % (metric, (x, y))
+                if not cells:
+                    check(nearest_x[x, y] == -1 and nearest_y[x, y] == -1, name + ' has no nearest cell')
+                    continue
+                expected = min(metric_distance(metric, u - x, v - y) for u, v in cells)
+                check(abs(distances[x, y] - expected) < 1e-3, name + ' distance')
+                u, v = nearest_x[x, y], nearest_y[x, y]
+                check(level[u, v] == 0 and abs(metric_distance(metric, u - x, v - y) - expected) < 1e-3, name + ' nearest cell')
+
+    # distances are rounded into integer arrays
+    out = rl.Array(width, height)
+    level.distance_transform(0, out=out)
+    if cells:
+        x, y = width - 1, height - 1
+        expected = min(metric_distance(rl.DISTANCE_EUCLIDEAN, u - x, v - y) for u, v in cells)
+        check(abs(out[x, y] - expected) <= 0.5, 'rounded into out')
+
+for width, height, chance in [(23, 17, 20), (1, 30, 5), (40, 2, 3), (9, 9, 1000)]:
+    check_transform(width, height, chance)
+report()
@@ -0,0 +1,64 @@
+import rl
+from checks import check_same, check_raises, report
+
+# checks that fused expressions give the same result as chained array operators
+
+def check_int32(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-20, 20)
+    b = rl.Array(width, height)
+    b.random_int(1, 9) # divisor, never zero
+    c = rl.Array(width, height)
+    c.random_int(0, 1)
+    ea, eb, ec = rl.expr(a), rl.expr(b), rl.expr(c)
+
+    cases = [
+        ('a + b * 3', (ea + eb * 3).eval(), a + b * 3),
+        ('(a - 2) * b', ((ea - 2) * eb).eval(), (a - 2) * b),
+        ('a / b + a % b', (ea / eb + ea % eb).eval(), a / b + a % b),
+        ('7 - a', (7 - ea).eval(), 7 - a),
+        ('-a & ~b | c', (-ea & ~eb | ec).eval(), -a & ~b | c),
+        ('b << 2 ^ a >> 1', (eb << 2 ^ ea >> 1).eval(), b << 2 ^ a >> 1),
+        ('abs(a) * c', (abs(ea) * ec).eval(), a.absolute() * c),
+        ('(a > 3) & b.equals(5) | c', ((ea > 3) & eb.equals(5) | ec).eval(), (a > 3) & b.equals(5) | c),
+        ('a <= b, a >= 0', ((ea <= eb) + (ea >= 0)).eval(), (a <= b) + (a >= 0)),
+        ('a.not_equals(b) * 2', (ea.not_equals(eb) * 2).eval(), a.not_equals(b) * 2),
+    ]
+    for name, fused, unfused in cases:
+        check_same(fused, unfused, name)
+
+def check_float32(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-20, 20)
+    b = rl.Array(width, height)
+    b.random_int(1, 9)
+    f = rl.Array(width, height, rl.FLOAT32)
+    a.copy_to(f)
+    f /= 8
+    g = rl.Array(width, height, rl.FLOAT32)
+    b.copy_to(g)
+    g /= 4
+    ef, eg = rl.expr(f), rl.expr(g)
+    check_same((ef * eg - ef / eg).eval(), f * g - f / g, 'f * g - f / g')
+    check_same((-ef + 0.5).eval(), -f + 0.5, '-f + 0.5')
+
+def check_out(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-20, 20)
+    b = rl.Array(width, height)
+    b.random_int(1, 9)
+    expected = a + b * 3
+    out = rl.Array(width, height)
+    (rl.expr(a) + rl.expr(b) * 3).eval(out=out)
+    check_same(out, expected, 'into out')
+    hp = a.copy()
+    (rl.expr(hp) + b * 3).eval(out=hp)
+    check_same(hp, expected, 'into an operand')
+    view = rl.Array(width + 1, height)
+    check_raises(lambda: (rl.expr(view[1:, :]) + 1).eval(out=view[:width, :]), 'overlapping out rejected')
+
+for width, height in [(37, 23), (1, 50)]:
+    check_int32(width, height)
+    check_float32(width, height)
+    check_out(width, height)
+report()
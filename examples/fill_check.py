@@ -0,0 +1,80 @@
+import rl
+from checks import check, check_same, report
+
+# checks scanline flood fill and label_components against a cell by cell fill
+
+def neighbors(use_diagonals):
+    if use_diagonals:
+        return [(-1, -1), (0, -1), (1, -1), (-1, 0), (1, 0), (-1, 1), (0, 1), (1, 1)]
+    return [(0, -1), (-1, 0), (1, 0), (0, 1)]
+
+# returns the cells of the region of (x, y)
+def region(a, x, y, use_diagonals):
+    width, height = a.width(), a.height()
+    initial = a[x, y]
+    seen = {(x, y)}
+    stack = [(x, y)]
+    while stack:
+        x, y = stack.pop()
+        for dx, dy in neighbors(use_diagonals):
+            u, v = x + dx, y + dy
+            if 0 <= u < width and 0 <= v < height and (u, v) not in seen and a[u, v] == initial:
+                seen.add((u, v))
+                stack.append((u, v))
+    return seen
+
+def check_flood_fill(width, height):
+    level = rl.Array(width, height)
+    level.random_int(0, 2)
+    for use_diagonals in [False, True]:
+        for k in range(20):
+            x, y = rl.random_int(0, width - 1), rl.random_int(0, height - 1)
+            cells = region(level, x, y, use_diagonals)
+            expected = level.copy()
+            for u, v in cells:
+                expected[u, v] = 9
+            filled = level.copy()
+            name = 'fill from %s use_diagonals %s' % ((x, y), use_diagonals)
+            check(filled.flood_fill(x, y, 9, use_diagonals) == len(cells), name + ' size')
+            check_same(filled, expected, name)
+
+    # filling with the same value changes nothing but still counts the region
+    same = level.copy()
+    check(same.flood_fill(0, 0, level[0, 0]) == len(region(level, 0, 0, False)), 'same value size')
+    check_same(same, level, 'same value')
+
+def check_label_components(width, height):
+    level = rl.Array(width, height)
+    level.random_int(0, 2)
+    for value in [None, 1]:
+        for use_diagonals in [False, True]:
+            labels, components = level.label_components(value, use_diagonals)
+            name = 'value %s use_diagonals %s' % (value, use_diagonals)
+            seen = set()
+            for y in range(height):
+                for x in range(width):
+                    label = labels[x, y]
+                    if label == 0:
+                        check(value is not None and level[x, y] != value, name + ' cell %s labelled' % ((x, y),))
+                        continue
+                    if label in seen:
+                        continue
+                    seen.add(label)
+                    cells = region(level, x, y, use_diagonals)
+                    xs = [u for u, v in cells]
+                    ys = [v for u, v in cells]
+                    box = (len(cells), min(xs), min(ys), max(xs) - min(xs) + 1, max(ys) - min(ys) + 1)
+                    check(components[label - 1] == box, name + ' component %d' % label)
+                    check(all(labels[u, v] == label for u, v in cells), name + ' region of label %d' % label)
+            check(len(seen) == len(components), name + ' component count')
+
+    # a value out of the range of the dtype matches no cell, instead of its truncation
+    small = rl.Array(width, height, rl.UINT8)
+    level.copy_to(small)
+    labels, components = small.label_components(257)
+    check(len(components) == 0 and labels.max() == 0, 'value out of range labels nothing')
+
+for width, height in [(41, 29), (70, 5)]:
+    check_flood_fill(width, height)
+    check_label_components(width, height)
+report()
@@ -0,0 +1,39 @@
+import rl
+from checks import check, check_same, check_raises, random_level, report
+
+# checks that batched fields of view match the ones computed one at a time
+
+def random_viewers(width, height, count):
+    return [(rl.random_int(0, width - 1), rl.random_int(0, height - 1), rl.random_int(1, 12)) for i in range(count)]
+
+def check_batch(width, height):
+    level = random_level(width, height)
+    viewers = random_viewers(width, height, 100)
+    for algorithm in [rl.FOV_SHADOWCAST, rl.FOV_RAYCAST]:
+        for light_walls in [False, True]:
+            serial = [level.field_of_view(x, y, radius, light_walls=light_walls, algorithm=algorithm) for x, y, radius in viewers]
+            for threads in [1, 0]:
+                rl.set_thread_count(threads)
+                batch = level.field_of_view_batch(viewers, light_walls=light_walls, algorithm=algorithm)
+                for viewer, a, b in zip(viewers, serial, batch):
+                    check_same(b, a, 'algorithm %d light_walls %s threads %d viewer %s' % (algorithm, light_walls, rl.get_thread_count(), viewer))
+
+def check_out(width, height):
+    level = random_level(width, height)
+    viewers = random_viewers(width, height, 20)
+    out = [rl.Array(width, height) for v in viewers]
+    result = level.field_of_view_batch(viewers, out=out)
+    check(all(a is b for a, b in zip(out, result)), 'out arrays returned')
+    for viewer, a in zip(viewers, out):
+        x, y, radius = viewer
+        check_same(a, level.field_of_view(x, y, radius), 'viewer %s into out' % (viewer,))
+
+    shared = rl.Array(width, height)
+    overlapping = rl.Array(width + 1, height)
+    for name, arrays in [('shared', [shared, shared]), ('overlapping views', [overlapping[:width, :], overlapping[1:, :]]), ('level', [level, shared])]:
+        check_raises(lambda: level.field_of_view_batch(viewers[:2], out=arrays), name + ' out rejected')
+
+for width, height in [(60, 40), (33, 71)]:
+    check_batch(width, height)
+    check_out(width, height)
+report()
@@ -0,0 +1,54 @@
+import rl
+from checks import check, check_same, check_raises, random_level, report
+
+# checks field of view algorithms: shadowcasting is symmetric, and both
+# algorithms see the same disk when nothing blocks the view
+
+def random_floors(level, count):
+    floors = []
+    while len(floors) < count:
+        x, y = rl.random_int(0, level.width() - 1), rl.random_int(0, level.height() - 1)
+        if level[x, y] == 0:
+            floors.append((x, y))
+    return floors
+
+def check_symmetry(width, height, radius):
+    level = random_level(width, height)
+    floors = random_floors(level, 40)
+    fovs = [level.field_of_view(x, y, radius) for x, y in floors]
+    for i in range(len(floors)):
+        for j in range(i):
+            xi, yi = floors[i]
+            xj, yj = floors[j]
+            check(fovs[i][xj, yj] == fovs[j][xi, yi], 'shadowcast symmetric between %s and %s' % (floors[i], floors[j]))
+
+def check_open_level(width, height, radius):
+    empty = rl.Array(width, height)
+    for x, y in [(width // 2, height // 2), (2, 3), (width - 1, height - 1)]:
+        disk = rl.Array(width, height)
+        for j in range(height):
+            for i in range(width):
+                if (i - x) ** 2 + (j - y) ** 2 <= radius * radius:
+                    disk[i, j] = 1
+        for algorithm in [rl.FOV_SHADOWCAST, rl.FOV_RAYCAST]:
+            check_same(empty.field_of_view(x, y, radius, algorithm=algorithm), disk, 'algorithm %d sees a disk from %s' % (algorithm, (x, y)))
+
+def check_out(width, height, radius):
+    level = random_level(width, height)
+    x, y = random_floors(level, 1)[0]
+    for algorithm in [rl.FOV_SHADOWCAST, rl.FOV_RAYCAST]:
+        expected = level.field_of_view(x, y, radius, algorithm=algorithm)
+        out = rl.Array(width, height)
+        out.fill(7)
+        check(level.field_of_view(x, y, radius, algorithm=algorithm, out=out) is out, 'out array returned')
+        check_same(out, expected, 'algorithm %d into an array' % algorithm)
+        bits = rl.Bitmask(width, height)
+        level.field_of_view(x, y, radius, algorithm=algorithm, out=bits)
+        check_same(bits.to_array(), expected, 'algorithm %d into a bitmask' % algorithm)
+    check_raises(lambda: level.field_of_view(x, y, radius, out=level), 'level as out rejected')
+
+for width, height, radius in [(40, 30, 8), (65, 20, 12)]:
+    check_symmetry(width, height, radius)
+    check_open_level(width, height, radius)
+    check_out(width, height, radius)
+report()
@@ -0,0 +1,57 @@
+import rl
+from checks import check_same, report
+
+# checks the three ways apply_kernel is computed (box, separable, generic)
+# against the direct per-cell formula, and against each other
+
+def truncated_div(a, b):
+    q = abs(a) // b
+    return q if a >= 0 else -q
+
+# sum of taps inside the array divided by the sum of their absolute values
+def direct(a, kernel):
+    width, height = a.width(), a.height()
+    kw, kh = kernel.width(), kernel.height()
+    result = rl.Array(width, height)
+    for y in range(height):
+        for x in range(width):
+            total = count = 0
+            for j in range(kh):
+                for i in range(kw):
+                    value = kernel[i, j]
+                    u, v = x + i - kw // 2, y + j - kh // 2
+                    if value != 0 and 0 <= u < width and 0 <= v < height:
+                        total += value * a[u, v]
+                        count += abs(value)
+            result[x, y] = truncated_div(total, count) if count else 0
+    return result
+
+kernels = [
+    ('box 3x3', [[1, 1, 1], [1, 1, 1], [1, 1, 1]]),
+    ('box 4x2 negative', [[-2, -2, -2, -2], [-2, -2, -2, -2]]),
+    ('separable gaussian', [[1, 2, 1], [2, 4, 2], [1, 2, 1]]),
+    ('separable sobel', [[1, 0, -1], [2, 0, -2], [1, 0, -1]]),
+    ('generic laplacian', [[0, 1, 0], [1, -4, 1], [0, 1, 0]]),
+    ('generic 5x3', [[3, 0, 1, -2, 5], [0, 0, 7, 1, 1], [2, -1, 0, 0, 4]]),
+]
+
+def check_kernels(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-1000, 1000)
+    for name, values in kernels:
+        kernel = rl.array_from_list(values)
+        check_same(a.apply_kernel(kernel), direct(a, kernel), '%s on %dx%d' % (name, width, height))
+
+    # a box padded with zeros is no longer a box but factors, zero taps are ignored
+    box = a.apply_kernel(rl.array_from_list([[1, 1, 1], [1, 1, 1], [1, 1, 1]]))
+    padded = a.apply_kernel(rl.array_from_list([[0, 1, 1, 1, 0], [0, 1, 1, 1, 0], [0, 1, 1, 1, 0]]))
+    check_same(box, padded, 'box and separable agree')
+
+    out = rl.Array(width, height)
+    kernel = rl.array_from_list([[1, 2, 1], [2, 4, 2], [1, 2, 1]])
+    a.apply_kernel(kernel, out=out)
+    check_same(out, a.apply_kernel(kernel), 'into out')
+
+for width, height in [(23, 17), (2, 9), (40, 1)]:
+    check_kernels(width, height)
+report()
@@ -0,0 +1,76 @@
+import rl
+from checks import check, check_same, check_raises, report
+
+# checks that operators writing to out give the same result as the allocating ones
+
+def operands(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-20, 20)
+    b = rl.Array(width, height)
+    b.random_int(1, 9)
+    return a, b
+
+def check_out(width, height):
+    a, b = operands(width, height)
+    mask = rl.Array(width, height)
+    mask.random_int(0, 1)
+    binary = [
+        ('equals', a.equals), ('not_equals', a.not_equals), ('greater', a.greater), ('less', a.less),
+        ('greater_equal', a.greater_equal), ('less_equal', a.less_equal),
+        ('bitwise_and', a.bitwise_and), ('bitwise_or', a.bitwise_or), ('bitwise_xor', a.bitwise_xor),
+        ('right_shift', a.right_shift), ('add', a.add), ('subtract', a.subtract),
+        ('multiply', a.multiply), ('divide', a.divide), ('mod', a.mod),
+    ]
+    for name, method in binary:
+        for other in [b, 3]:
+            name = name + (' array' if other is b else ' value')
+            expected = method(other)
+            out = rl.Array(width, height)
+            check(method(other, out=out) is out, name + ' returns out')
+            check_same(out, expected, name)
+
+    check_same(b.left_shift(2, out=rl.Array(width, height)), b << 2, 'left_shift')
+    check_same(a.negative(out=rl.Array(width, height)), -a, 'negative')
+    check_same(a.invert(out=rl.Array(width, height)), ~a, 'invert')
+    check_same(a.absolute(out=rl.Array(width, height)), a * (a > 0) - a * (a < 0), 'absolute')
+    check_same(a.copy(out=rl.Array(width, height)), a, 'copy')
+    check_same(a.copy(mask, out=rl.Array(width, height)), a * mask, 'masked copy')
+
+def check_out_as_operand(width, height):
+    a, b = operands(width, height)
+    c = a.copy()
+    c.add(b, out=c)
+    check_same(c, a + b, 'add into the first operand')
+    c = b.copy()
+    a.subtract(c, out=c)
+    check_same(c, a - b, 'subtract into the second operand')
+    c = a.copy()
+    c.negative(out=c)
+    check_same(c, -a, 'negative into the operand')
+    # in-place operators write to the left operand only
+    c, d = a.copy(), b.copy()
+    c -= d
+    check_same(c, a - b, 'in-place subtract')
+    check_same(d, b, 'in-place subtract leaves the right operand')
+
+def check_overlapping_out(width, height):
+    wide = rl.Array(width + 1, height)
+    left, right = wide[:width, :], wide[1:, :]
+    for name, f in [('add', lambda: left.add(1, out=right)), ('add other', lambda: left.add(left, out=right)),
+            ('absolute', lambda: left.absolute(out=right)), ('copy', lambda: left.copy(out=right))]:
+        check_raises(f, name + ' into an overlapping view rejected')
+
+    # in-place operators and copy_to accept overlapping views
+    wide.random_int(-20, 20)
+    expected = wide[:width, :] + wide[1:, :]
+    left += right
+    check_same(left, expected, 'in-place add of an overlapping view')
+    expected = wide[1:, :].copy()
+    right.copy_to(left)
+    check_same(left, expected, 'copy_to an overlapping view')
+
+for width, height in [(29, 17), (64, 3)]:
+    check_out(width, height)
+    check_out_as_operand(width, height)
+    check_overlapping_out(width, height)
+report()
@@ -0,0 +1,49 @@
+import rl
+from checks import check, check_same, check_raises, report
+
+# checks reductions, with and without masks and axes, against per-cell loops
+
+def cells(a, mask=None):
+    return [a[x, y] for y in range(a.height()) for x in range(a.width()) if mask is None or mask[x, y]]
+
+def check_reductions(width, height):
+    a = rl.Array(width, height)
+    a.random_int(-5, 20)
+    mask = rl.Array(width, height)
+    mask.random_int(0, 1)
+    mask[0, 0] = 1
+    for m in [None, mask]:
+        name = 'mask' if m is not None else 'no mask'
+        values = cells(a, m)
+        check(a.min(mask=m) == min(values), name + ' min')
+        check(a.max(mask=m) == max(values), name + ' max')
+        x, y = a.argmin(mask=m)
+        check(a[x, y] == min(values) and (m is None or m[x, y]), name + ' argmin')
+        x, y = a.argmax(mask=m)
+        check(a[x, y] == max(values) and (m is None or m[x, y]), name + ' argmax')
+        check(a.sum(mask=m) == sum(values), name + ' sum')
+        check(a.count(3, mask=m) == values.count(3), name + ' count')
+        check(a.histogram(10, mask=m) == [values.count(v) for v in range(10)], name + ' histogram')
+        distinct = sorted(set(values))
+        check(a.unique(mask=m) == (distinct, [values.count(v) for v in distinct]), name + ' unique')
+
+    rows = rl.Array(1, height)
+    columns = rl.Array(width, 1)
+    for y in range(height):
+        rows[0, y] = sum(cells(a[:, y:y + 1]))
+    for x in range(width):
+        columns[x, 0] = sum(cells(a[x:x + 1, :]))
+    check_same(a.sum(axis=0), rows, 'sum of rows')
+    check_same(a.sum(axis=1), columns, 'sum of columns')
+    out = rl.Array(1, height)
+    check(a.max(axis=0, out=out) is out, 'max of rows into out')
+    for y in range(height):
+        rows[0, y] = max(cells(a[:, y:y + 1]))
+    check_same(out, rows, 'max of rows')
+
+    check_raises(lambda: a.histogram(10, mask=rl.Array(width + 1, height)), 'histogram with a mask of another size rejected')
+    check_raises(lambda: rl.Array(width, height, rl.FLOAT32).histogram(10), 'histogram of a float array rejected')
+
+for width, height in [(31, 19), (1, 40), (70, 2)]:
+    check_reductions(width, height)
+report()
@@ -4,4 +4,5 @@
 #include "rogue_filesystem.h"
 #include "rogue_index.h"
 #include "rogue_random.h"
+#include "rogue_thread.h"
 #include "rogue_tty.h"
@@ -1,10 +1,189 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "rogue_array.h"
 #include "rogue_util.h"
 #include "rogue_random.h"
+#include "rogue_thread.h"
+#include "miniz.h"
+
+// element-wise kernels work on contiguous rows so that the compiler can vectorize them.
+// on x86 each kernel is compiled twice, for the baseline (sse2 on x86-64) and for avx2,
+// and the avx2 version is selected at runtime. other targets get the baseline only.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__EMSCRIPTEN__)
+#define USE_AVX2_KERNELS
+static int has_avx2 = -1;
+static inline int cpu_has_avx2() {
+  if(has_avx2 < 0) has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  return has_avx2;
+}
+#endif
+
+#ifdef USE_AVX2_KERNELS
+#define rl_kernel(name, params, args, ...) \
+  static void name##_baseline params __VA_ARGS__ \
+  __attribute__((target("avx2"))) static void name##_avx2 params __VA_ARGS__ \
+  static void name params { if(cpu_has_avx2()) name##_avx2 args; else name##_baseline args; }
+#define rl_reduce_kernel(type, name, params, args, ...) \
+  static type name##_baseline params __VA_ARGS__ \
+  __attribute__((target("avx2"))) static type name##_avx2 params __VA_ARGS__ \
+  static type name params { return cpu_has_avx2() ? name##_avx2 args : name##_baseline args; }
+// gcc only vectorizes table lookups with gathers when tuning for a cpu where they are fast
+#define rl_gather_kernel(name, params, args, ...) \
+  static void name##_baseline params __VA_ARGS__ \
+  __attribute__((target("avx2,tune=haswell"))) static void name##_avx2 params __VA_ARGS__ \
+  static void name params { if(cpu_has_avx2()) name##_avx2 args; else name##_baseline args; }
+#else
+#define rl_kernel(name, params, args, ...) static void name params __VA_ARGS__
+#define rl_reduce_kernel(type, name, params, args, ...) static type name params __VA_ARGS__
+#define rl_gather_kernel rl_kernel
+#endif
+
+// kernels take rows of any dtype and are compiled once per element type T
+#define rl_dtype_switch(dtype, ...) \
+  switch(dtype) { \
+    case DTYPE_UINT8: { typedef uint8_t T; __VA_ARGS__; break; } \
+    case DTYPE_INT16: { typedef int16_t T; __VA_ARGS__; break; } \
+    case DTYPE_FLOAT32: { typedef float T; __VA_ARGS__; break; } \
+    default: { typedef VALUE T; __VA_ARGS__; break; } \
+  }
+
+// for operators which do not apply to floats, callers check the dtype first
+#define rl_int_dtype_switch(dtype, ...) \
+  switch(dtype) { \
+    case DTYPE_UINT8: { typedef uint8_t T; __VA_ARGS__; break; } \
+    case DTYPE_INT16: { typedef int16_t T; __VA_ARGS__; break; } \
+    default: { typedef VALUE T; __VA_ARGS__; break; } \
+  }
+
+// scalars are passed as doubles, integer types wrap out of range values instead of saturating
+#define rl_convert(T, value) ((T) 0.5 != 0 ? (T) (value) : (T) (int64_t) (value))
+
+// whether a scalar is exactly representable in T, so that comparisons with it can match
+#define rl_representable(T, value) ((double) rl_convert(T, value) == (value))
+
+rl_kernel(row_fill, (void* dest, double value, int dtype, uint32_t n), (dest, value, dtype, n), {
+  rl_dtype_switch(dtype, T v = rl_convert(T, value); T* d = dest; for(uint32_t i = 0; i < n; i++) d[i] = v);
+})
+
+rl_kernel(row_replace, (void* dest, double value1, double value2, int dtype, uint32_t n), (dest, value1, value2, dtype, n), {
+  rl_dtype_switch(dtype,
+    if(!rl_representable(T, value1)) break;
+    T v1 = rl_convert(T, value1); T v2 = rl_convert(T, value2); T* d = dest;
+    for(uint32_t i = 0; i < n; i++) d[i] = d[i] == v1 ? v2 : d[i]);
+})
+
+#define rl_unary_kernel(name, dtype_switch, expression) \
+  rl_kernel(row_##name, (void* dest, const void* a, int dtype, uint32_t n), (dest, a, dtype, n), { \
+    dtype_switch(dtype, T* d = dest; const T* x = a; for(uint32_t i = 0; i < n; i++) d[i] = expression); \
+  })
+
+rl_unary_kernel(minus, rl_dtype_switch, -x[i])
+rl_unary_kernel(not, rl_dtype_switch, !x[i])
+rl_unary_kernel(invert, rl_int_dtype_switch, ~x[i])
+rl_unary_kernel(abs, rl_dtype_switch, x[i] > 0 ? x[i] : -x[i])
+
+// reductions take an optional row of flags from a mask, cells with a zero flag are left out
+rl_kernel(row_nonzero, (uint8_t* dest, const void* a, int dtype, uint32_t n), (dest, a, dtype, n), {
+  rl_dtype_switch(dtype, const T* x = a; for(uint32_t i = 0; i < n; i++) dest[i] = x[i] != 0);
+})
+
+rl_reduce_kernel(uint32_t, row_count, (const void* a, double value, const uint8_t* flags, int dtype, uint32_t n), (a, value, flags, dtype, n), {
+  uint32_t count = 0;
+  rl_dtype_switch(dtype,
+    if(!rl_representable(T, value)) break;
+    T v = rl_convert(T, value); const T* x = a;
+    if(flags == NULL) for(uint32_t i = 0; i < n; i++) count += x[i] == v;
+    else for(uint32_t i = 0; i < n; i++) count += (x[i] == v) & flags[i]);
+  return count;
+})
+
+rl_reduce_kernel(double, row_sum, (const void* a, const uint8_t* flags, int dtype, uint32_t n), (a, flags, dtype, n), {
+  if(dtype == DTYPE_FLOAT32) {
+    const float* x = a;
+    double sum = 0;
+    if(flags == NULL) for(uint32_t i = 0; i < n; i++) sum += x[i];
+    else for(uint32_t i = 0; i < n; i++) sum += flags[i] ? x[i] : 0;
+    return sum;
+  }
+  int64_t sum = 0;
+  rl_int_dtype_switch(dtype,
+    const T* x = a;
+    if(flags == NULL) for(uint32_t i = 0; i < n; i++) sum += x[i];
+    else for(uint32_t i = 0; i < n; i++) sum += x[i] & -(T) flags[i]);
+  return (double) sum;
+})
+
+// blocking cells are replaced by the neutral value with a bit mask, which gcc vectorizes unlike a conditional
+#define rl_int_min_max(T, compare, neutral) { \
+    T is_enabled = rl_representable(T, blocking) ? (T) -1 : 0; \
+    T b = rl_convert(T, blocking); \
+    T result = rl_convert(T, acc); \
+    const T* x = a; \
+    if(flags == NULL) { \
+      for(uint32_t i = 0; i < n; i++) { \
+        T is_blocking = -(T) (x[i] == b) & is_enabled; \
+        T value = (x[i] & ~is_blocking) | ((T) (neutral) & is_blocking); \
+        result = value compare result ? value : result; \
+      } \
+    } else { \
+      for(uint32_t i = 0; i < n; i++) { \
+        T is_blocking = (-(T) (x[i] == b) & is_enabled) | (T) (flags[i] - 1); \
+        T value = (x[i] & ~is_blocking) | ((T) (neutral) & is_blocking); \
+        result = value compare result ? value : result; \
+      } \
+    } \
+    return result; \
+  }
+
+#define rl_min_max_kernel(name, compare, neutral_i32, neutral_u8, neutral_i16, neutral_f32) \
+  rl_reduce_kernel(double, row_##name, (const void* a, double blocking, const uint8_t* flags, double acc, int dtype, uint32_t n), (a, blocking, flags, acc, dtype, n), { \
+    switch(dtype) { \
+      case DTYPE_UINT8: rl_int_min_max(uint8_t, compare, neutral_u8); \
+      case DTYPE_INT16: rl_int_min_max(int16_t, compare, neutral_i16); \
+      case DTYPE_FLOAT32: { \
+        float b = blocking, result = acc; \
+        const float* x = a; \
+        if(flags == NULL) for(uint32_t i = 0; i < n; i++) result = x[i] != b && x[i] compare result ? x[i] : result; \
+        else for(uint32_t i = 0; i < n; i++) result = flags[i] && x[i] != b && x[i] compare result ? x[i] : result; \
+        return result; \
+      } \
+      default: rl_int_min_max(VALUE, compare, neutral_i32); \
+    } \
+  })
+
+rl_min_max_kernel(min, <, VALUE_MAX, UINT8_MAX, INT16_MAX, FLT_MAX)
+rl_min_max_kernel(max, >, VALUE_MIN, 0, INT16_MIN, -FLT_MAX)
+
+#define rl_row_op_kernels(name, operator, dtype_switch) \
+  rl_kernel(row_left_##name##_value, (void* dest, const void* a, double value, int dtype, uint32_t n), (dest, a, value, dtype, n), { \
+    dtype_switch(dtype, T v = rl_convert(T, value); T* d = dest; const T* x = a; for(uint32_t i = 0; i < n; i++) d[i] = (v operator x[i])); \
+  }) \
+  rl_kernel(row_right_##name##_value, (void* dest, const void* a, double value, int dtype, uint32_t n), (dest, a, value, dtype, n), { \
+    dtype_switch(dtype, T v = rl_convert(T, value); T* d = dest; const T* x = a; for(uint32_t i = 0; i < n; i++) d[i] = (x[i] operator v)); \
+  }) \
+  rl_kernel(row_##name##_other, (void* dest, const void* a, const void* b, int dtype, uint32_t n), (dest, a, b, dtype, n), { \
+    dtype_switch(dtype, T* d = dest; const T* x = a; const T* y = b; for(uint32_t i = 0; i < n; i++) d[i] = (x[i] operator y[i])); \
+  })
+
+// for algorithms which keep intermediate states or large values in cells
+#define require_int32(a) { if((a)->dtype != DTYPE_INT32) rl_error("int32 array expected"); }
+
+// spans of memory covered by two arrays intersect, only element-wise operations can write to their input
+static int arrays_overlap(array_t* a, array_t* b) {
+  if(a->width == 0 || a->height == 0 || b->width == 0 || b->height == 0) return 0;
+  const char* a_end = rl_array_cell(a, a->width - 1, a->height - 1);
+  const char* b_end = rl_array_cell(b, b->width - 1, b->height - 1);
+  return (const char*) a->values <= b_end && (const char*) b->values <= a_end;
+}
+
+// element-wise results can be one of their operands, each cell being read before it is written
+static void check_alias(array_t* a, array_t* result) {
+  int is_same = a->values == result->values && a->stride == result->stride && a->width == result->width && a->height == result->height;
+  if(!is_same && arrays_overlap(a, result)) rl_error("result cannot overlap operands");
+}
 
 static int hex2int(char ch) {
   if (ch >= '0' && ch <= '9') return ch - '0';
@@ -13,37 +192,45 @@ static int hex2int(char ch) {
   return 7;
 }
 
-array_t* rl_array_new(uint32_t width, uint32_t height) {
+array_t* rl_array_new_dtype(uint32_t width, uint32_t height, int dtype) {
+  if(dtype < DTYPE_INT32 || dtype > DTYPE_FLOAT32) rl_error("invalid dtype %d", dtype);
   array_t *a = rl_malloc(sizeof(array_t));
-  a->values = rl_malloc(sizeof(VALUE) * width * height);
-  memset(a->values, 0, sizeof(VALUE) * width * height);
+  a->values = rl_malloc(rl_dtype_size(dtype) * width * height);
+  memset(a->values, 0, rl_dtype_size(dtype) * width * height);
   a->stride = 0;
   a->is_view = 0;
+  a->dtype = dtype;
   a->width = width;
   a->height = height;
   return a;
 }
 
-array_t* rl_array_from_string(const char* string) {
+array_t* rl_array_new(uint32_t width, uint32_t height) {
+  return rl_array_new_dtype(width, height, DTYPE_INT32);
+}
+
+array_t* rl_array_from_string(const char* string, int dtype) {
   const char* start = string, *end=NULL;
   int width = strtol(start, (char**) &end, 10); start = end + 1;
   int height = strtol(start, (char**) &end, 10); start = end + 1;
-  array_t* a = rl_array_new(width, height);
+  array_t* a = rl_array_new_dtype(width, height, dtype);
   for(int i = 0; i < width * height; i++) {
-    a->values[i] = strtol(start, (char**) &end, 10); 
+    rl_array_set_number(a, i % width, i / width, strtod(start, (char**) &end));
     start = end + 1;
   }
   return a;
 }
 
+// floats are written with enough digits to be read back exactly
 char* rl_array_to_string(array_t* a) {
   int allocated = 128, size = 0;
   char* result = malloc(allocated);
-  char buffer[16];
+  char buffer[32];
   snprintf(result, 128, "%d %d", a->width, a->height);
   size = strlen(result);
   for(int i = 0; i < a->width * a->height; i++) {
-    snprintf(buffer, 16, " %d", a->values[i]);
+    if(a->dtype == DTYPE_FLOAT32) snprintf(buffer, 32, " %.9g", rl_array_get_number(a, i % a->width, i / a->width));
+    else snprintf(buffer, 32, " %d", rl_array_load(a, i % a->width, i / a->width));
     if(size + strlen(buffer) + 1 > allocated) {
       allocated += allocated / 2;
       result = realloc(result, allocated);
@@ -54,6 +241,159 @@ char* rl_array_to_string(array_t* a) {
   return result;
 }
 
+// raw cell values in native byte order, rows are packed without the stride of views
+size_t rl_array_byte_size(array_t* a) {
+  return (size_t) rl_dtype_size(a->dtype) * a->width * a->height;
+}
+
+void rl_array_to_bytes(array_t* a, void* dest) {
+  size_t row_size = (size_t) rl_dtype_size(a->dtype) * a->width;
+  if(a->stride == 0) {
+    memcpy(dest, a->values, row_size * a->height);
+    return;
+  }
+  for(uint32_t j = 0; j < a->height; j++) memcpy((char*) dest + row_size * j, rl_array_row(a, j), row_size);
+}
+
+void rl_array_from_bytes(array_t* a, const void* src) {
+  size_t row_size = (size_t) rl_dtype_size(a->dtype) * a->width;
+  if(a->stride == 0) {
+    memcpy(a->values, src, row_size * a->height);
+    return;
+  }
+  for(uint32_t j = 0; j < a->height; j++) memcpy(rl_array_row(a, j), (const char*) src + row_size * j, row_size);
+}
+
+// palette lookups use a masked index rather than a branch, so that they compile to gathers
+rl_gather_kernel(row_palette, (uint32_t* restrict dest, const void* restrict a, const uint32_t* restrict palette, uint32_t size, int dtype, uint32_t n), (dest, a, palette, size, dtype, n), {
+  rl_int_dtype_switch(dtype,
+    const T* x = a;
+    for(int i = 0; i < (int) n; i++) {
+      int32_t index = x[i];
+      int32_t is_valid = -(int32_t) ((uint32_t) index < size);
+      dest[i] = palette[index & is_valid] & is_valid;
+    });
+})
+
+// writes the palette color of each cell to dest, with dest_stride pixels per row. out of range values give 0
+void rl_array_apply_palette(array_t* a, uint32_t* dest, uint32_t dest_stride, const uint32_t* palette, uint32_t palette_size) {
+  if(a->dtype == DTYPE_FLOAT32) rl_error("integer array expected");
+  if(palette_size == 0) rl_error("empty palette");
+  for(uint32_t j = 0; j < a->height; j++) row_palette(dest + (size_t) dest_stride * j, rl_array_row(a, j), palette, palette_size, a->dtype, a->width);
+}
+
+// binary serialization: a header of little-endian fields followed by the values, raw or deflated.
+// records can be concatenated, the header gives the size of the payload.
+#define ARRAY_MAGIC "RLA"
+#define ARRAY_VERSION 1
+#define ARRAY_HEADER_SIZE 20
+
+static int is_little_endian() {
+  uint16_t one = 1;
+  return *(uint8_t*) &one == 1;
+}
+
+static void swap_bytes(void* data, size_t count, int size) {
+  uint8_t* bytes = data;
+  for(size_t i = 0; i < count; i++, bytes += size) {
+    for(int k = 0; k < size / 2; k++) {
+      uint8_t tmp = bytes[k];
+      bytes[k] = bytes[size - 1 - k];
+      bytes[size - 1 - k] = tmp;
+    }
+  }
+}
+
+static void write_u32(uint8_t* dest, uint32_t value) {
+  for(int i = 0; i < 4; i++) dest[i] = (value >> (8 * i)) & 0xff;
+}
+
+static uint32_t read_u32(const uint8_t* src) {
+  return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t) src[3] << 24);
+}
+
+// worst case of tdefl for incompressible data, as in mz_deflateBound which is not built
+static size_t deflate_bound(size_t size) {
+  size_t blocks = 128 + size + (size / (31 * 1024) + 1) * 5;
+  size_t expanded = 128 + size * 110 / 100;
+  return blocks > expanded ? blocks : expanded;
+}
+
+size_t rl_array_serialized_bound(array_t* a, int compression) {
+  size_t raw_size = rl_array_byte_size(a);
+  if(compression == ARRAY_COMPRESS_DEFLATE) return ARRAY_HEADER_SIZE + deflate_bound(raw_size);
+  return ARRAY_HEADER_SIZE + raw_size;
+}
+
+// writes at most rl_array_serialized_bound bytes to dest and returns the size used
+// deflated values which are not smaller than the raw ones are stored raw
+size_t rl_array_serialize(array_t* a, int compression, void* dest) {
+  if(compression != ARRAY_COMPRESS_NONE && compression != ARRAY_COMPRESS_DEFLATE) rl_error("invalid compression %d", compression);
+  uint8_t* header = dest;
+  uint8_t* payload = header + ARRAY_HEADER_SIZE;
+  size_t raw_size = rl_array_byte_size(a);
+  size_t size = raw_size;
+  int elem_size = rl_dtype_size(a->dtype);
+  if(compression == ARRAY_COMPRESS_DEFLATE) {
+    const uint8_t* values = (const uint8_t*) a->values;
+    uint8_t* packed = NULL;
+    if(a->stride != 0 || !is_little_endian()) {
+      packed = malloc(raw_size);
+      rl_array_to_bytes(a, packed);
+      if(!is_little_endian()) swap_bytes(packed, raw_size / elem_size, elem_size);
+      values = packed;
+    }
+    // the zlib wrappers of miniz are not built, the stream is produced with tdefl directly
+    int flags = tdefl_create_comp_flags_from_zip_params(MZ_BEST_SPEED, 15, MZ_DEFAULT_STRATEGY); // 15 window bits with a zlib header
+    size_t compressed_size = tdefl_compress_mem_to_mem(payload, deflate_bound(raw_size), values, raw_size, flags);
+    if(compressed_size != 0 && compressed_size < raw_size) {
+      size = compressed_size;
+    } else {
+      compression = ARRAY_COMPRESS_NONE;
+    }
+    free(packed);
+  }
+  if(compression == ARRAY_COMPRESS_NONE) {
+    rl_array_to_bytes(a, payload);
+    if(!is_little_endian()) swap_bytes(payload, raw_size / elem_size, elem_size);
+  }
+  memcpy(header, ARRAY_MAGIC, 3);
+  header[3] = ARRAY_VERSION;
+  header[4] = a->dtype;
+  header[5] = compression;
+  header[6] = header[7] = 0;
+  write_u32(header + 8, a->width);
+  write_u32(header + 12, a->height);
+  write_u32(header + 16, size);
+  return ARRAY_HEADER_SIZE + size;
+}
+
+// returns NULL when data does not start with a valid record, otherwise sets used to the size of the record
+array_t* rl_array_deserialize(const void* data, size_t size, size_t* used) {
+  const uint8_t* header = data;
+  if(size < ARRAY_HEADER_SIZE || memcmp(header, ARRAY_MAGIC, 3) != 0 || header[3] != ARRAY_VERSION) return NULL;
+  int dtype = header[4], compression = header[5];
+  uint32_t width = read_u32(header + 8), height = read_u32(header + 12), payload_size = read_u32(header + 16);
+  if(dtype > DTYPE_FLOAT32 || compression > ARRAY_COMPRESS_DEFLATE) return NULL;
+  if(payload_size > size - ARRAY_HEADER_SIZE) return NULL;
+  uint64_t raw_size = (uint64_t) width * height * rl_dtype_size(dtype);
+  if(raw_size > UINT32_MAX || (compression == ARRAY_COMPRESS_NONE && raw_size != payload_size)) return NULL;
+  const uint8_t* payload = header + ARRAY_HEADER_SIZE;
+  array_t* a = rl_array_new_dtype(width, height, dtype);
+  if(compression == ARRAY_COMPRESS_NONE) {
+    memcpy(a->values, payload, raw_size);
+  } else {
+    size_t uncompressed_size = tinfl_decompress_mem_to_mem(a->values, raw_size, payload, payload_size, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    if(uncompressed_size != raw_size) {
+      rl_array_free(a);
+      return NULL;
+    }
+  }
+  if(!is_little_endian()) swap_bytes(a->values, raw_size / rl_dtype_size(dtype), rl_dtype_size(dtype));
+  *used = ARRAY_HEADER_SIZE + payload_size;
+  return a;
+}
+
 array_t* rl_array_view(array_t* b, int x, int y, uint32_t width, uint32_t height) {
   if(x >= (int) b->width || y >= (int) b->height) rl_error("empty view");
   if(x < 0) { width -= -x; x = 0; }
@@ -61,16 +401,17 @@ array_t* rl_array_view(array_t* b, int x, int y, uint32_t width, uint32_t height
   if(x + width > b->width) width = b->width - x;
   if(y + height > b->height) height = b->height - y;
   array_t *a = rl_malloc(sizeof(array_t));
-  a->values = &rl_array_value(b, x, y);
+  a->values = rl_array_cell(b, x, y);
   a->stride = b->stride + b->width - width;
   a->is_view = 1;
+  a->dtype = b->dtype;
   a->width = width;
   a->height = height;
   return a;
 }
 
 void rl_array_free(array_t* a) {
-  if(!a->is_view) rl_free(a->values, sizeof(VALUE) * a->width * a->height);
+  if(!a->is_view) rl_free(a->values, rl_dtype_size(a->dtype) * a->width * a->height);
   rl_free(a, sizeof(array_t));
 }
 uint32_t rl_array_width(array_t* a) {
@@ -83,7 +424,7 @@ uint32_t rl_array_height(array_t* a) {
 
 VALUE rl_array_get(array_t* a, int x, int y) {
   if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
-    return rl_array_value(a, x, y);
+    return rl_array_load(a, x, y);
   }
   fprintf(stderr, "invalid array get at (%d, %d)\n", x, y);
   return VALUE_MIN;
@@ -91,47 +432,74 @@ VALUE rl_array_get(array_t* a, int x, int y) {
 
 void rl_array_set(array_t* a, int x, int y, VALUE value) {
   if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
-    rl_array_value(a, x, y) = value;
+    rl_array_store(a, x, y, value);
+  } else {
+    fprintf(stderr, "invalid array set at (%d, %d)\n", x, y);
+  }
+}
+
+double rl_array_get_number(array_t* a, int x, int y) {
+  if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
+    rl_dtype_switch(a->dtype, return *(T*) rl_array_cell(a, x, y));
+  }
+  fprintf(stderr, "invalid array get at (%d, %d)\n", x, y);
+  return VALUE_MIN;
+}
+
+void rl_array_set_number(array_t* a, int x, int y, double value) {
+  if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
+    rl_dtype_switch(a->dtype, *(T*) rl_array_cell(a, x, y) = rl_convert(T, value));
   } else {
     fprintf(stderr, "invalid array set at (%d, %d)\n", x, y);
   }
 }
 
-void rl_array_fill(array_t *a, VALUE value) {
+VALUE rl_array_load_typed(array_t* a, int x, int y) {
+  rl_dtype_switch(a->dtype, return (VALUE) *(T*) rl_array_cell(a, x, y));
+  return 0;
+}
+
+void rl_array_store_typed(array_t* a, int x, int y, VALUE value) {
+  rl_dtype_switch(a->dtype, *(T*) rl_array_cell(a, x, y) = (T) value);
+}
+
+void rl_array_fill(array_t *a, double value) {
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      rl_array_value(a, i, j) = value;
+    row_fill(rl_array_row(a, j), value, a->dtype, a->width);
 }
 
-void rl_array_replace(array_t *a, VALUE value1, VALUE value2) {
+void rl_array_replace(array_t *a, double value1, double value2) {
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      if(rl_array_value(a, i, j) == value1) rl_array_value(a, i, j) = value2;
+    row_replace(rl_array_row(a, j), value1, value2, a->dtype, a->width);
 }
 
 void rl_array_random_int(array_t *a, int lower, int upper) {
   if(lower > upper) lower = upper;
   for(int j = 0; j < a->height; j++)
     for(int i = 0; i < a->width; i++)
-      rl_array_value(a, i, j) = rl_random_next() % (1 + upper - lower) + lower;
+      rl_array_store(a, i, j, rl_random_next() % (1 + upper - lower) + lower);
 }
 
 void rl_array_random(array_t *a) {
   for(int j = 0; j < a->height; j++)
     for(int i = 0; i < a->width; i++)
-      rl_array_value(a, i, j) = (VALUE) rl_random_next(); // / UINT_MAX;
+      rl_array_store(a, i, j, (VALUE) rl_random_next()); // / UINT_MAX;
 }
 
 void rl_array_random_2d(array_t *a, int32_t x, int32_t y) {
   for(int j = 0; j < a->height; j++)
     for(int i = 0; i < a->width; i++)
-      rl_array_value(a, i, j) = (VALUE) rl_random_2d(x + i, y + j); // / UINT_MAX;
+      rl_array_store(a, i, j, (VALUE) rl_random_2d(x + i, y + j)); // / UINT_MAX;
 }
 
 void rl_array_print(array_t *a) {
   for(int y = 0; y < a->height; y++) {
     for(int x = 0; x < a->width; x++) {
-      VALUE value = rl_array_value(a, x, y);
+      if(a->dtype == DTYPE_FLOAT32) {
+        printf("%g ", rl_array_get_number(a, x, y));
+        continue;
+      }
+      VALUE value = rl_array_load(a, x, y);
       if(value == VALUE_MAX) printf("∞ ");
       else if(value == VALUE_MIN) printf("-∞ ");
       else printf(VALUE_FORMAT " ", value);
@@ -142,9 +510,10 @@ void rl_array_print(array_t *a) {
 
 void rl_array_draw_line(array_t* a, int x1, int y1, int x2, int y2, VALUE value) {
   int x = x1, y = y1, has_next = 1;
-  for(rl_walk_line_start(x1, y1, x2, y2); has_next; has_next = rl_walk_line_next(&x, &y)) {
+  line_t line;
+  for(rl_line_start(&line, x1, y1, x2, y2); has_next; has_next = rl_line_next(&line, &x, &y)) {
     if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
-      rl_array_value(a, x, y) = value;
+      rl_array_store(a, x, y, value);
     }
   }
 }
@@ -156,12 +525,12 @@ void rl_array_draw_rect(array_t *a, int x, int y, uint32_t width, uint32_t heigh
   if(x + width >= a->width) width = a->width - x;
   if(y + height >= a->height) height = a->height - y;
   for(int j = y; j < y + height; j++) {
-    rl_array_value(a, x, j) = value;
-    rl_array_value(a, x + width - 1, j) = value;
+    rl_array_store(a, x, j, value);
+    rl_array_store(a, x + width - 1, j, value);
   }
   for(int i = x; i < x + width; i++) {
-    rl_array_value(a, i, y) = value;
-    rl_array_value(a, i, y + height - 1) = value;
+    rl_array_store(a, i, y, value);
+    rl_array_store(a, i, y + height - 1, value);
   }
 }
 
@@ -174,7 +543,7 @@ void rl_array_fill_rect(array_t *a, int x, int y, uint32_t width, uint32_t heigh
   for(int j = y; j < y + height; j++) {
     for(int i = x; i < x + width; i++) {
       if(i >= 0 && i < a->width && j > 0 && j < a->height) {
-        rl_array_value(a, i, j) = value;
+        rl_array_store(a, i, j, value);
       }
     }
   }
@@ -183,9 +552,10 @@ void rl_array_fill_rect(array_t *a, int x, int y, uint32_t width, uint32_t heigh
 // TODO: symetric line of sight
 int rl_array_can_see(array_t *a, int x1, int y1, int x2, int y2, VALUE blocking) {
   int x = x1, y = y1, has_next = 1;
-  for(rl_walk_line_start(x1, y1, x2, y2); has_next; has_next = rl_walk_line_next(&x, &y)) {
+  line_t line;
+  for(rl_line_start(&line, x1, y1, x2, y2); has_next; has_next = rl_line_next(&line, &x, &y)) {
     if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
-      if(rl_array_value(a, x, y) == blocking) return 0;
+      if(rl_array_load(a, x, y) == blocking) return 0;
     } else return 0;
   }
   //if(x1 == x2 && y1 == y2 && rl_array_value(a, x1, y1) != blocking) return 1;
@@ -230,8 +600,16 @@ int rl_array_can_see(array_t *a, int x1, int y1, int x2, int y2, VALUE blocking)
   fov_test(xc+y, yc-x); \
   fov_test(xc-y, yc-x);
 
-array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE blocking, int light_walls) {
-  array_t* result = rl_array_new(a->width, a->height);
+// field of view results go either to an array or to a bitmask
+typedef struct {
+  array_t* array;
+  bitmask_t* bits;
+} fov_result_t;
+
+#define fov_mark(r, x, y) ((r)->array != NULL ? rl_array_store((r)->array, x, y, 1) : (void) rl_bitmask_set_value((r)->bits, x, y))
+#define fov_is_marked(r, x, y) ((r)->array != NULL ? rl_array_load((r)->array, x, y) != 0 : rl_bitmask_value((r)->bits, x, y))
+
+static void fov_raycast(array_t* a, fov_result_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls) {
   int x, y;
   /*for(y = yc - radius; y <= yc + radius; y++) {
     for(x = xc - radius; x <= xc + radius; x++) {
@@ -245,50 +623,51 @@ array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE bl
   }*/
   int x2, y2;
   int radius_sqr = radius * radius;
+  line_t line;
   for(x2 = xc - radius; x2 <= xc + radius; x2++) {
     int x = xc, y = yc, has_next = 1;
-    for(rl_walk_line_start(xc, yc, x2, yc - radius); has_next; has_next = rl_walk_line_next(&x, &y)) {
+    for(rl_line_start(&line, xc, yc, x2, yc - radius); has_next; has_next = rl_line_next(&line, &x, &y)) {
       if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
         int distance = (x - xc) * (x - xc) + (y - yc) * (y - yc);
-        if(distance > radius_sqr || rl_array_value(a, x, y) == blocking) {
+        if(distance > radius_sqr || rl_array_load(a, x, y) == blocking) {
           break;
         } else {
-          rl_array_value(result, x, y) = 1;
+          fov_mark(result, x, y);
         }
       } else break;
     }
     x = xc, y = yc, has_next = 1;
-    for(rl_walk_line_start(xc, yc, x2, yc + radius); has_next; has_next = rl_walk_line_next(&x, &y)) {
+    for(rl_line_start(&line, xc, yc, x2, yc + radius); has_next; has_next = rl_line_next(&line, &x, &y)) {
       if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
         int distance = (x - xc) * (x - xc) + (y - yc) * (y - yc);
-        if(distance > radius_sqr || rl_array_value(a, x, y) == blocking) {
+        if(distance > radius_sqr || rl_array_load(a, x, y) == blocking) {
           break;
         } else {
-          rl_array_value(result, x, y) = 1;
+          fov_mark(result, x, y);
         }
       } else break;
     }
   }
   for(y2 = yc - radius; y2 <= yc + radius; y2++) {
     int x = xc, y = yc, has_next = 1;
-    for(rl_walk_line_start(xc, yc, xc - radius, y2); has_next; has_next = rl_walk_line_next(&x, &y)) {
+    for(rl_line_start(&line, xc, yc, xc - radius, y2); has_next; has_next = rl_line_next(&line, &x, &y)) {
       if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
         int distance = (x - xc) * (x - xc) + (y - yc) * (y - yc);
-        if(distance > radius_sqr || rl_array_value(a, x, y) == blocking) {
+        if(distance > radius_sqr || rl_array_load(a, x, y) == blocking) {
           break;
         } else {
-          rl_array_value(result, x, y) = 1;
+          fov_mark(result, x, y);
         }
       } else break;
     }
     x = xc, y = yc, has_next = 1;
-    for(rl_walk_line_start(xc, yc, xc + radius, y2); has_next; has_next = rl_walk_line_next(&x, &y)) {
+    for(rl_line_start(&line, xc, yc, xc + radius, y2); has_next; has_next = rl_line_next(&line, &x, &y)) {
       if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
         int distance = (x - xc) * (x - xc) + (y - yc) * (y - yc);
-        if(distance > radius_sqr || rl_array_value(a, x, y) == blocking) {
+        if(distance > radius_sqr || rl_array_load(a, x, y) == blocking) {
           break;
         } else {
-          rl_array_value(result, x, y) = 1;
+          fov_mark(result, x, y);
         }
       } else break;
     }
@@ -298,199 +677,660 @@ array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE bl
     const int dy[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
     for(y = yc - radius; y <= yc + radius; y++) {
       for(x = xc - radius; x <= xc + radius; x++) {
-        if(x >= 0 && x < result->width && y >= 0 && y < result->height && rl_array_value(a, x, y) == blocking) {
+        if(x >= 0 && x < a->width && y >= 0 && y < a->height && rl_array_load(a, x, y) == blocking) {
           int distance = (x - xc) * (x - xc) + (y - yc) * (y - yc);
           if(distance < radius * radius) {
             int sum = 0;
             for(int k = 0; k < 8; k++) {
               int i = x + dx[k];
               int j = y + dy[k];
-              if(i >= 0 && i < result->width && j >= 0 && j < result->height) {
-                if(rl_array_value(a, i, j) != blocking && rl_array_value(result, i, j)) {
+              if(i >= 0 && i < a->width && j >= 0 && j < a->height) {
+                if(rl_array_load(a, i, j) != blocking && fov_is_marked(result, i, j)) {
                   sum++;
                   break;
                 }
               }
             }
-            if(sum > 0) rl_array_value(result, x, y) = 1;
+            if(sum > 0) fov_mark(result, x, y);
           }
         }
       }
     }
   }
+}
+
+// symmetric shadowcasting, see https://www.albertford.com/shadowcasting/
+// slopes are kept as fractions num / den with den > 0
+typedef struct {
+  array_t* a;
+  fov_result_t* result;
+  int xc, yc, radius;
+  VALUE blocking;
+  int light_walls;
+  int quadrant;
+} shadowcast_t;
+
+static inline int floor_div(int num, int den) {
+  return num >= 0 ? num / den : -((-num + den - 1) / den);
+}
+
+static inline void shadowcast_transform(shadowcast_t* s, int depth, int col, int* x, int* y) {
+  switch(s->quadrant) {
+    case 0: *x = s->xc + col; *y = s->yc - depth; break;
+    case 1: *x = s->xc + depth; *y = s->yc + col; break;
+    case 2: *x = s->xc + col; *y = s->yc + depth; break;
+    default: *x = s->xc - depth; *y = s->yc + col; break;
+  }
+}
+
+// out of bounds cells block light
+static inline int shadowcast_is_wall(shadowcast_t* s, int x, int y) {
+  if(x < 0 || x >= s->a->width || y < 0 || y >= s->a->height) return 1;
+  return rl_array_load(s->a, x, y) == s->blocking;
+}
+
+static void shadowcast_scan(shadowcast_t* s, int depth, int start_num, int start_den, int end_num, int end_den) {
+  if(depth > s->radius) return;
+  int radius_sqr = s->radius * s->radius;
+  // round_ties_up(depth * start) and round_ties_down(depth * end)
+  int min_col = floor_div(2 * depth * start_num + start_den, 2 * start_den);
+  int max_col = -floor_div(-(2 * depth * end_num - end_den), 2 * end_den);
+  int prev = -1; // -1 for none, 0 for floor, 1 for wall
+  for(int col = min_col; col <= max_col; col++) {
+    int x, y;
+    shadowcast_transform(s, depth, col, &x, &y);
+    int wall = shadowcast_is_wall(s, x, y);
+    if(!(x < 0 || x >= s->a->width || y < 0 || y >= s->a->height) && col * col + depth * depth <= radius_sqr) {
+      if(wall) {
+        if(s->light_walls) fov_mark(s->result, x, y);
+      } else if(col * start_den >= depth * start_num && col * end_den <= depth * end_num) {
+        fov_mark(s->result, x, y);
+      }
+    }
+    if(prev == 1 && !wall) {
+      start_num = 2 * col - 1;
+      start_den = 2 * depth;
+    }
+    if(prev == 0 && wall) {
+      shadowcast_scan(s, depth + 1, start_num, start_den, 2 * col - 1, 2 * depth);
+    }
+    prev = wall;
+  }
+  if(prev == 0) shadowcast_scan(s, depth + 1, start_num, start_den, end_num, end_den);
+}
+
+static void fov_shadowcast(array_t* a, fov_result_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls) {
+  if(xc < 0 || xc >= a->width || yc < 0 || yc >= a->height) return;
+  if(rl_array_load(a, xc, yc) != blocking || light_walls) fov_mark(result, xc, yc);
+  shadowcast_t s = {a, result, xc, yc, radius, blocking, light_walls, 0};
+  for(s.quadrant = 0; s.quadrant < 4; s.quadrant++) {
+    shadowcast_scan(&s, 1, -1, 1, 1, 1);
+  }
+}
+
+static void field_of_view(array_t* a, fov_result_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm) {
+  if(result->array != NULL) {
+    for(int j = 0; j < result->array->height; j++)
+      memset(rl_array_row(result->array, j), 0, rl_dtype_size(result->array->dtype) * result->array->width);
+  } else {
+    rl_bitmask_fill(result->bits, 0);
+  }
+  if(algorithm == FOV_RAYCAST) fov_raycast(a, result, xc, yc, radius, blocking, light_walls);
+  else fov_shadowcast(a, result, xc, yc, radius, blocking, light_walls);
+}
+
+void rl_array_field_of_view_into(array_t* a, array_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm) {
+  if(a->width != result->width || a->height != result->height) rl_error("size mismatch");
+  if(arrays_overlap(a, result)) rl_error("result cannot overlap operands");
+  fov_result_t output = {result, NULL};
+  field_of_view(a, &output, xc, yc, radius, blocking, light_walls, algorithm);
+}
+
+void rl_array_field_of_view_bitmask(array_t* a, bitmask_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm) {
+  if(a->width != result->width || a->height != result->height) rl_error("size mismatch");
+  fov_result_t output = {NULL, result};
+  field_of_view(a, &output, xc, yc, radius, blocking, light_walls, algorithm);
+}
+
+typedef struct {
+  array_t* a;
+  array_t** results;
+  const fov_viewer_t* viewers;
+  VALUE blocking;
+  int light_walls, algorithm;
+} fov_batch_t;
+
+static void fov_batch_task(void* data, int index) {
+  fov_batch_t* batch = data;
+  const fov_viewer_t* viewer = &batch->viewers[index];
+  fov_result_t output = {batch->results[index], NULL};
+  field_of_view(batch->a, &output, viewer->x, viewer->y, viewer->radius, batch->blocking, batch->light_walls, batch->algorithm);
+}
+
+void rl_array_field_of_view_batch(array_t* a, array_t** results, const fov_viewer_t* viewers, int num_viewers, VALUE blocking, int light_walls, int algorithm) {
+  // errors cannot be raised from worker threads, check everything beforehand
+  for(int i = 0; i < num_viewers; i++) {
+    if(a->width != results[i]->width || a->height != results[i]->height) rl_error("size mismatch");
+    if(arrays_overlap(results[i], a)) rl_error("result cannot overlap operands");
+    for(int j = 0; j < i; j++)
+      if(arrays_overlap(results[i], results[j])) rl_error("field of view results must not be shared");
+  }
+  fov_batch_t batch = {a, results, viewers, blocking, light_walls, algorithm};
+  rl_parallel_for(num_viewers, fov_batch_task, &batch);
+}
+
+array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm) {
+  array_t* result = rl_array_new(a->width, a->height);
+  rl_array_field_of_view_into(a, result, xc, yc, radius, blocking, light_walls, algorithm);
   return result;
 }
 
-#define coords2index(x, y) (x + y * a->width)
-path_t* rl_array_shortest_path(array_t* a, int x1, int y1, int x2, int y2, VALUE blocking) {
+// indexed binary min-heap on cell numbers, ordered by priority then by larger cost so far
+#define heap_less(f, i, j) ((f)->priority[i] < (f)->priority[j] \
+    || ((f)->priority[i] == (f)->priority[j] && (f)->cost_so_far[i] > (f)->cost_so_far[j]))
+
+static void heap_up(path_finder_t* f, uint32_t position) {
+  uint32_t cell = f->heap[position];
+  while(position > 0) {
+    uint32_t parent = (position - 1) / 2;
+    if(!heap_less(f, cell, f->heap[parent])) break;
+    f->heap[position] = f->heap[parent];
+    f->heap_position[f->heap[position]] = position;
+    position = parent;
+  }
+  f->heap[position] = cell;
+  f->heap_position[cell] = position;
+}
+
+static void heap_down(path_finder_t* f, uint32_t position) {
+  uint32_t cell = f->heap[position];
+  while(1) {
+    uint32_t child = position * 2 + 1;
+    if(child >= f->heap_size) break;
+    if(child + 1 < f->heap_size && heap_less(f, f->heap[child + 1], f->heap[child])) child++;
+    if(!heap_less(f, f->heap[child], cell)) break;
+    f->heap[position] = f->heap[child];
+    f->heap_position[f->heap[position]] = position;
+    position = child;
+  }
+  f->heap[position] = cell;
+  f->heap_position[cell] = position;
+}
+
+static void heap_push_or_decrease(path_finder_t* f, uint32_t cell) {
+  if(f->heap_position[cell] == PATH_NOT_QUEUED) {
+    f->heap[f->heap_size] = cell;
+    heap_up(f, f->heap_size++);
+  } else {
+    heap_up(f, f->heap_position[cell]);
+  }
+}
+
+static uint32_t heap_pop(path_finder_t* f) {
+  uint32_t cell = f->heap[0];
+  f->heap_position[cell] = PATH_NOT_QUEUED;
+  f->heap_size--;
+  if(f->heap_size > 0) {
+    f->heap[0] = f->heap[f->heap_size];
+    heap_down(f, 0);
+  }
+  return cell;
+}
+
+path_finder_t* rl_path_finder_new() {
+  path_finder_t* f = calloc(1, sizeof(path_finder_t));
+  return f;
+}
+
+void rl_path_finder_free(path_finder_t* f) {
+  free(f->came_from);
+  free(f->cost_so_far);
+  free(f->priority);
+  free(f->heap);
+  free(f->heap_position);
+  free(f->generation);
+  free(f);
+}
+
+// grow scratch buffers if needed and invalidate previous search in O(1) by bumping the generation
+static void path_finder_prepare(path_finder_t* f, uint32_t num) {
+  if(num > f->allocated) {
+    free(f->came_from);
+    free(f->cost_so_far);
+    free(f->priority);
+    free(f->heap);
+    free(f->heap_position);
+    free(f->generation);
+    f->came_from = malloc(sizeof(uint32_t) * num);
+    f->cost_so_far = malloc(sizeof(VALUE) * num);
+    f->priority = malloc(sizeof(VALUE) * num);
+    f->heap = malloc(sizeof(uint32_t) * num);
+    f->heap_position = malloc(sizeof(uint32_t) * num);
+    f->generation = calloc(num, sizeof(uint32_t));
+    f->allocated = num;
+    f->current_generation = 0;
+  }
+  f->current_generation++;
+  if(f->current_generation == 0) {
+    memset(f->generation, 0, sizeof(uint32_t) * f->allocated);
+    f->current_generation = 1;
+  }
+  f->heap_size = 0;
+}
+
+#define coords2index(x, y) ((x) + (y) * a->width)
+#define path_visited(f, i) ((f)->generation[i] == (f)->current_generation)
+path_t* rl_path_finder_shortest_path(path_finder_t* f, array_t* a, int x1, int y1, int x2, int y2, VALUE blocking) {
   if(x1 < 0 || x1 >= a->width || y1 < 0 || y1 >= a->height) return NULL;
   if(x2 < 0 || x2 >= a->width || y2 < 0 || y2 >= a->height) return NULL;
   if(x1 == x2 && y1 == y2) return NULL;
-  uint32_t num = a->width * a->height;
-  uint32_t* came_from = malloc(sizeof(uint32_t) * num);
-  VALUE* cost_so_far = malloc(sizeof(VALUE) * num);
-  for(int i = 0; i < num; i++) cost_so_far[i] = VALUE_MAX; // unprocessed
-  int queue_allocated = 16;
-  uint32_t* queue = malloc(sizeof(uint32_t) * queue_allocated);
-  VALUE* priority = malloc(sizeof(VALUE) * queue_allocated);
-  uint32_t size = 0;
-  priority[size] = 0;
-  queue[size++] = coords2index(x1, y1);
-  cost_so_far[queue[0]] = 0;
-  int neighbor_x[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
-  int neighbor_y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
-  while(size > 0) {
-    // find lowest cost node
-    VALUE min = priority[0];
-    uint32_t argmin = 0;
-    for(uint32_t i = 1; i < size; i++) {
-      if(priority[i] < min) {
-        min = priority[i];
-        argmin = i;
-      }
-    }
-    uint32_t current = queue[argmin];
-    queue[argmin] = queue[size - 1];
-    priority[argmin] = priority[size - 1];
-    size--;
+  path_finder_prepare(f, a->width * a->height);
+  const int neighbor_x[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  const int neighbor_y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  uint32_t start = coords2index(x1, y1);
+  uint32_t goal = coords2index(x2, y2);
+  f->generation[start] = f->current_generation;
+  f->cost_so_far[start] = 0;
+  f->priority[start] = 0;
+  f->heap_position[start] = PATH_NOT_QUEUED;
+  heap_push_or_decrease(f, start);
+  int found = 0;
+  while(f->heap_size > 0 && !found) {
+    uint32_t current = heap_pop(f);
     int current_x = current % a->width;
     int current_y = current / a->width;
+    VALUE new_cost = f->cost_so_far[current] + 1;
     for(uint32_t i = 0; i < 8; i++) {
       int next_x = current_x + neighbor_x[i];
       int next_y = current_y + neighbor_y[i];
-      uint32_t next = next_y * a->width + next_x;
-      if(next_x == x2 && next_y == y2) {
-        cost_so_far[next] = cost_so_far[current] + 1;
-        came_from[next] = current;
-        size = 0;
+      if(next_x < 0 || next_x >= a->width || next_y < 0 || next_y >= a->height) continue;
+      uint32_t next = coords2index(next_x, next_y);
+      if(next == goal) {
+        // the goal may itself be blocking (such as a monster targeting the player)
+        f->generation[next] = f->current_generation;
+        f->cost_so_far[next] = new_cost;
+        f->came_from[next] = current;
+        found = 1;
         break;
       }
-      if(next_x >= 0 && next_x < a->width && next_y >= 0 && next_y < a->height) {
-        VALUE new_cost = cost_so_far[current] + 1;
-        if(rl_array_value(a, next_x, next_y) != blocking && new_cost < cost_so_far[next]) {
-          cost_so_far[next] = new_cost;
-          int dx = x2 - next_x;
-          int dy = y2 - next_y;
-          int distance = abs(dx) + abs(dy);
-          priority[size] = new_cost + distance;
-          queue[size] = next;
-          came_from[next] = current;
-          size++;
-          if(size >= queue_allocated) {
-            queue_allocated += queue_allocated / 2;
-            if(queue_allocated > num) queue_allocated = num;
-            queue = realloc(queue, sizeof(uint32_t) * queue_allocated);
-            priority = realloc(priority, sizeof(VALUE) * queue_allocated);
-          }
-        }
-      }
+      if(rl_array_load(a, next_x, next_y) == blocking) continue;
+      if(!path_visited(f, next)) {
+        f->generation[next] = f->current_generation;
+        f->heap_position[next] = PATH_NOT_QUEUED;
+      } else if(new_cost >= f->cost_so_far[next]) continue;
+      // chebyshev distance is admissible for 8-connected unit moves
+      int dx = abs(x2 - next_x);
+      int dy = abs(y2 - next_y);
+      f->cost_so_far[next] = new_cost;
+      f->priority[next] = new_cost + (dx > dy ? dx : dy);
+      f->came_from[next] = current;
+      heap_push_or_decrease(f, next);
     }
   }
-  uint32_t current = x2 + y2 * a->width;
-  path_t* path = NULL;
-  if(cost_so_far[current] != VALUE_MAX) {
-    uint32_t path_size = (uint32_t) cost_so_far[current];
-    path = malloc(sizeof(path_t) + sizeof(point_t) * (path_size - 1));
-    path->size = path_size;
-    while(path_size > 0 && cost_so_far[current] != 0 && cost_so_far[current] != VALUE_MAX) {
-      path_size--;
-      path->points[path_size].x = current % a->width;
-      path->points[path_size].y = current / a->width;
-      current = came_from[current];
-    }
+  if(!found) return NULL;
+  uint32_t current = goal;
+  uint32_t path_size = (uint32_t) f->cost_so_far[current];
+  path_t* path = malloc(sizeof(path_t) + sizeof(point_t) * (path_size - 1));
+  path->size = path_size;
+  while(path_size > 0) {
+    path_size--;
+    path->points[path_size].x = current % a->width;
+    path->points[path_size].y = current / a->width;
+    current = f->came_from[current];
   }
-  free(queue);
-  free(priority);
-  free(came_from);
-  free(cost_so_far);
   return path;
 }
 
-void rl_array_dijkstra(array_t* a) {
-  const int offset_x[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
-  const int offset_y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
-
-  int converged = 0;
-  do {
-    converged = 1;
-    for(int y = 0; y < a->height; y++) {
-      for(int x = 0; x < a->width; x++) {
-        if(rl_array_value(a, x, y) <= 0) continue;
-        VALUE min = VALUE_MAX;
-        for(int i = 0; i < 8; i++) {
-          if(x + offset_x[i] >= 0 && x + offset_x[i] < a->width
-              && y + offset_y[i] >= 0 && y + offset_y[i] < a->height) {
-            VALUE value = rl_array_value(a, x + offset_x[i], y + offset_y[i]);
-            if(value >= 0 && value < min) {
-              min = value;
-            }
-          }
-        }
-        if(min != INT_MAX && min + 1 < rl_array_value(a, x, y)) {
-          rl_array_value(a, x, y) = min + 1;
-          converged = 0;
-        }
+path_t* rl_array_shortest_path(array_t* a, int x1, int y1, int x2, int y2, VALUE blocking) {
+  path_finder_t* f = rl_path_finder_new();
+  path_t* path = rl_path_finder_shortest_path(f, a, x1, y1, x2, y2, blocking);
+  rl_path_finder_free(f);
+  return path;
+}
+
+// dial's algorithm: cells are kept in doubly-linked lists, one per distance modulo (max_cost + 1)
+// the queue is empty after each use, so its buffers can be kept between runs
+#define BUCKET_NONE UINT32_MAX
+#define BUCKET_HEAD (UINT32_MAX - 1)
+
+static void dial_remove(dial_queue_t* q, uint32_t cell, VALUE distance) {
+  uint32_t bucket = (uint32_t) distance % q->num_buckets;
+  if(q->prev[cell] == BUCKET_HEAD) q->buckets[bucket] = q->next[cell];
+  else q->next[q->prev[cell]] = q->next[cell];
+  if(q->next[cell] != BUCKET_NONE) q->prev[q->next[cell]] = q->prev[cell];
+  q->prev[cell] = BUCKET_NONE;
+  q->queued--;
+}
+
+static void dial_push(dial_queue_t* q, uint32_t cell, VALUE distance) {
+  uint32_t bucket = (uint32_t) distance % q->num_buckets;
+  q->next[cell] = q->buckets[bucket];
+  q->prev[cell] = BUCKET_HEAD;
+  if(q->buckets[bucket] != BUCKET_NONE) q->prev[q->buckets[bucket]] = cell;
+  q->buckets[bucket] = cell;
+  q->queued++;
+}
+
+static void dial_init(dial_queue_t* q, uint32_t num, uint32_t num_buckets) {
+  q->num_buckets = num_buckets;
+  q->queued = 0;
+  q->buckets = rl_malloc(sizeof(uint32_t) * num_buckets);
+  q->next = rl_malloc(sizeof(uint32_t) * num);
+  q->prev = rl_malloc(sizeof(uint32_t) * num);
+  for(uint32_t i = 0; i < num_buckets; i++) q->buckets[i] = BUCKET_NONE;
+  for(uint32_t i = 0; i < num; i++) q->prev[i] = BUCKET_NONE;
+}
+
+static void dial_release(dial_queue_t* q, uint32_t num) {
+  rl_free(q->buckets, sizeof(uint32_t) * q->num_buckets);
+  rl_free(q->next, sizeof(uint32_t) * num);
+  rl_free(q->prev, sizeof(uint32_t) * num);
+}
+
+static int compare_by_value(const void* a, const void* b) {
+  const VALUE va = ((const VALUE*) a)[0], vb = ((const VALUE*) b)[0];
+  return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static VALUE dijkstra_max_cost(array_t* cost) {
+  VALUE max_cost = 1;
+  if(cost != NULL) {
+    for(int j = 0; j < cost->height; j++)
+      for(int i = 0; i < cost->width; i++)
+        if(rl_array_value(cost, i, j) > max_cost) max_cost = rl_array_value(cost, i, j);
+  }
+  if(max_cost > DIJKSTRA_MAX_COST) rl_error("movement cost too large (%d > %d)", max_cost, DIJKSTRA_MAX_COST);
+  return max_cost;
+}
+
+static const int dijkstra_offset_x[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int dijkstra_offset_y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+// propagate distances from seed cells, whose current value is their tentative distance
+// seeds is an array of (value, cell) pairs and gets sorted by value
+static void dijkstra_propagate(dial_queue_t* q, array_t* a, array_t* cost, VALUE* seeds, uint32_t num_seeds) {
+  if(num_seeds == 0) return;
+  qsort(seeds, num_seeds, sizeof(VALUE) * 2, compare_by_value);
+
+  uint32_t seed = 0;
+  VALUE distance = seeds[0];
+  while(1) {
+    // seeds enter the queue when the sweep reaches their value, unless they were improved since
+    for(; seed < num_seeds && seeds[seed * 2] == distance; seed++) {
+      uint32_t cell = (uint32_t) seeds[seed * 2 + 1];
+      if(q->prev[cell] == BUCKET_NONE && rl_array_value(a, cell % a->width, cell / a->width) == distance)
+        dial_push(q, cell, distance);
+    }
+    if(q->queued == 0) {
+      if(seed >= num_seeds) break;
+      distance = seeds[seed * 2];
+      continue;
+    }
+    uint32_t bucket = (uint32_t) distance % q->num_buckets;
+    while(q->buckets[bucket] != BUCKET_NONE) {
+      uint32_t cell = q->buckets[bucket];
+      dial_remove(q, cell, distance);
+      int x = cell % a->width;
+      int y = cell / a->width;
+      for(int k = 0; k < 8; k++) {
+        int i = x + dijkstra_offset_x[k];
+        int j = y + dijkstra_offset_y[k];
+        if(i < 0 || i >= a->width || j < 0 || j >= a->height) continue;
+        VALUE value = rl_array_value(a, i, j);
+        if(value <= distance) continue; // negative cells are walls, goals stay at 0
+        VALUE step = cost == NULL ? 1 : rl_array_value(cost, i, j);
+        if(step < 1) continue;
+        int64_t new_distance = (int64_t) distance + step;
+        if(new_distance >= value) continue;
+        uint32_t next = i + j * a->width;
+        if(q->prev[next] != BUCKET_NONE) dial_remove(q, next, value);
+        rl_array_value(a, i, j) = (VALUE) new_distance;
+        dial_push(q, next, (VALUE) new_distance);
       }
     }
-  } while(!converged);
+    distance++;
+  }
 }
 
-VALUE rl_array_min(array_t *a, VALUE blocking) {
-  VALUE min = VALUE_MAX;
+void rl_array_dijkstra(array_t* a, array_t* cost) {
+  if(cost != NULL && (cost->width != a->width || cost->height != a->height))
+    rl_error("size mismatch");
+  require_int32(a);
+  if(cost != NULL) require_int32(cost);
+  VALUE max_cost = dijkstra_max_cost(cost);
+  uint32_t num_seeds = 0;
   for(int j = 0; j < a->height; j++)
     for(int i = 0; i < a->width; i++) {
       VALUE value = rl_array_value(a, i, j);
-      if(value != blocking && value < min) min = value;
+      if(value >= 0 && value != VALUE_MAX) num_seeds++;
     }
-  return min;
-}
-
-VALUE rl_array_max(array_t* a, VALUE blocking) {
-  VALUE max = VALUE_MIN;
+  VALUE* seeds = malloc(sizeof(VALUE) * 2 * (num_seeds + 1));
+  num_seeds = 0;
   for(int j = 0; j < a->height; j++)
     for(int i = 0; i < a->width; i++) {
       VALUE value = rl_array_value(a, i, j);
-      if(value != blocking && value > max) max = value;
+      if(value >= 0 && value != VALUE_MAX) {
+        seeds[num_seeds * 2] = value;
+        seeds[num_seeds * 2 + 1] = i + j * a->width;
+        num_seeds++;
+      }
     }
-  return max;
+  dial_queue_t q;
+  dial_init(&q, a->width * a->height, max_cost + 1);
+  dijkstra_propagate(&q, a, cost, seeds, num_seeds);
+  dial_release(&q, a->width * a->height);
+  free(seeds);
 }
 
-point_t rl_array_argmin(array_t* a, VALUE blocking) {
-  VALUE min = VALUE_MAX;
-  int argmin_x = 0, argmin_y = 0;
-  for(uint32_t y = 0; y < a->height; y++) {
-    for(uint32_t x = 0; x < a->height; x++) {
-      VALUE value = rl_array_value(a, x, y);
-      if(value != blocking && value < min) {
-        min = value; argmin_x = x; argmin_y = y;
-      }
-    }
+distance_map_t* rl_distance_map_new(array_t* level, VALUE blocking) {
+  uint32_t num = level->width * level->height;
+  distance_map_t* map = rl_malloc(sizeof(distance_map_t));
+  map->distances = rl_array_new(level->width, level->height);
+  for(int j = 0; j < level->height; j++)
+    for(int i = 0; i < level->width; i++)
+      rl_array_value(map->distances, i, j) = rl_array_load(level, i, j) == blocking ? -1 : VALUE_MAX;
+  dial_init(&map->queue, num, 2);
+  map->invalid = rl_malloc(sizeof(uint8_t) * num);
+  memset(map->invalid, 0, sizeof(uint8_t) * num);
+  map->invalid_cells = rl_malloc(sizeof(uint32_t) * num);
+  map->seeds = rl_malloc(sizeof(VALUE) * 2 * num);
+  return map;
+}
+
+void rl_distance_map_free(distance_map_t* map) {
+  uint32_t num = map->distances->width * map->distances->height;
+  dial_release(&map->queue, num);
+  rl_free(map->invalid, sizeof(uint8_t) * num);
+  rl_free(map->invalid_cells, sizeof(uint32_t) * num);
+  rl_free(map->seeds, sizeof(VALUE) * 2 * num);
+  rl_array_free(map->distances);
+  rl_free(map, sizeof(distance_map_t));
+}
+
+// best distance a cell can get from its neighbors not marked as invalid
+static VALUE distance_from_neighbors(distance_map_t* map, int x, int y) {
+  array_t* a = map->distances;
+  VALUE best = VALUE_MAX;
+  for(int k = 0; k < 8; k++) {
+    int i = x + dijkstra_offset_x[k];
+    int j = y + dijkstra_offset_y[k];
+    if(i < 0 || i >= a->width || j < 0 || j >= a->height) continue;
+    VALUE value = rl_array_value(a, i, j);
+    if(value < 0 || value == VALUE_MAX || map->invalid[i + j * a->width]) continue;
+    if(value + 1 < best) best = value + 1;
   }
-  point_t result = {argmin_x, argmin_y};
-  return result;
+  return best;
 }
 
-// TODO: remove point_t 
-point_t rl_array_argmax(array_t* a, VALUE blocking) {
-  VALUE max = VALUE_MIN;
-  int argmax_x = 0, argmax_y = 0;
-  for(uint32_t y = 0; y < a->height; y++) {
-    for(uint32_t x = 0; x < a->height; x++) {
-      VALUE value = rl_array_value(a, x, y);
-      if(value != blocking && value > max) {
-        max = value; argmax_x = x; argmax_y = y;
+// a cell lost its distance: invalidate the cells whose shortest paths all went through it, then
+// recompute them from the valid cells around that region
+static void distance_map_repair_increase(distance_map_t* map, int x, int y, int becomes_wall) {
+  array_t* a = map->distances;
+  dial_queue_t* q = &map->queue;
+  uint32_t start = x + y * a->width;
+  uint32_t num_invalid = 0;
+  VALUE distance = rl_array_value(a, x, y);
+  map->invalid[start] = 1;
+  map->invalid_cells[num_invalid++] = start;
+  dial_push(q, start, distance);
+  // cells are visited by increasing old distance so that every invalid support of a cell is known when it is checked
+  while(q->queued > 0) {
+    uint32_t bucket = (uint32_t) distance % q->num_buckets;
+    while(q->buckets[bucket] != BUCKET_NONE) {
+      uint32_t cell = q->buckets[bucket];
+      dial_remove(q, cell, distance);
+      int cx = cell % a->width, cy = cell / a->width;
+      for(int k = 0; k < 8; k++) {
+        int i = cx + dijkstra_offset_x[k];
+        int j = cy + dijkstra_offset_y[k];
+        if(i < 0 || i >= a->width || j < 0 || j >= a->height) continue;
+        uint32_t next = i + j * a->width;
+        VALUE value = rl_array_value(a, i, j);
+        if(value != distance + 1 || map->invalid[next]) continue;
+        if(distance_from_neighbors(map, i, j) == value) continue; // still supported by another cell
+        map->invalid[next] = 1;
+        map->invalid_cells[num_invalid++] = next;
+        dial_push(q, next, value);
       }
     }
+    distance++;
   }
-  point_t result = {argmax_x, argmax_y};
-  return result;
+  for(uint32_t n = 0; n < num_invalid; n++) {
+    uint32_t cell = map->invalid_cells[n];
+    rl_array_value(a, cell % a->width, cell / a->width) = VALUE_MAX;
+  }
+  if(becomes_wall) rl_array_value(a, x, y) = -1;
+  uint32_t num_seeds = 0;
+  for(uint32_t n = becomes_wall ? 1 : 0; n < num_invalid; n++) {
+    uint32_t cell = map->invalid_cells[n];
+    VALUE value = distance_from_neighbors(map, cell % a->width, cell / a->width);
+    if(value != VALUE_MAX) {
+      rl_array_value(a, cell % a->width, cell / a->width) = value;
+      map->seeds[num_seeds * 2] = value;
+      map->seeds[num_seeds * 2 + 1] = cell;
+      num_seeds++;
+    }
+  }
+  for(uint32_t n = 0; n < num_invalid; n++) map->invalid[map->invalid_cells[n]] = 0;
+  dijkstra_propagate(q, a, NULL, map->seeds, num_seeds);
+}
+
+// a cell got a lower distance: only the cells it improves need an update
+static void distance_map_repair_decrease(distance_map_t* map, int x, int y, VALUE new_value) {
+  array_t* a = map->distances;
+  rl_array_value(a, x, y) = new_value;
+  if(new_value == VALUE_MAX) return;
+  map->seeds[0] = new_value;
+  map->seeds[1] = x + y * a->width;
+  dijkstra_propagate(&map->queue, a, NULL, map->seeds, 1);
+}
+
+void rl_distance_map_add_goal(distance_map_t* map, int x, int y) {
+  array_t* a = map->distances;
+  if(x < 0 || x >= a->width || y < 0 || y >= a->height) rl_error("out of bounds");
+  if(rl_array_value(a, x, y) == 0) return;
+  distance_map_repair_decrease(map, x, y, 0);
+}
+
+void rl_distance_map_remove_goal(distance_map_t* map, int x, int y) {
+  array_t* a = map->distances;
+  if(x < 0 || x >= a->width || y < 0 || y >= a->height) rl_error("out of bounds");
+  if(rl_array_value(a, x, y) != 0) return;
+  distance_map_repair_increase(map, x, y, 0);
+}
+
+void rl_distance_map_set_blocking(distance_map_t* map, int x, int y, int is_blocking) {
+  array_t* a = map->distances;
+  if(x < 0 || x >= a->width || y < 0 || y >= a->height) rl_error("out of bounds");
+  VALUE value = rl_array_value(a, x, y);
+  if(is_blocking) {
+    if(value < 0) return;
+    if(value == VALUE_MAX) rl_array_value(a, x, y) = -1;
+    else distance_map_repair_increase(map, x, y, 1);
+  } else {
+    if(value >= 0) return;
+    distance_map_repair_decrease(map, x, y, distance_from_neighbors(map, x, y));
+  }
+}
+
+// largest and smallest values of each dtype, returned by min and max when all cells are blocking
+static const double dtype_max[] = {VALUE_MAX, UINT8_MAX, INT16_MAX, FLT_MAX};
+static const double dtype_min[] = {VALUE_MIN, 0, INT16_MIN, -FLT_MAX};
+
+// flags for the rows of a mask, NULL when there is no mask
+static uint8_t* mask_flags_new(array_t* a, array_t* mask) {
+  if(mask == NULL) return NULL;
+  if(mask->width != a->width || mask->height != a->height) rl_error("mask size mismatch");
+  return malloc(a->width > 0 ? a->width : 1);
+}
+
+static const uint8_t* mask_row_flags(array_t* mask, int j, uint8_t* flags) {
+  if(mask == NULL) return NULL;
+  row_nonzero(flags, rl_array_row(mask, j), mask->dtype, mask->width);
+  return flags;
+}
+
+double rl_array_min(array_t *a, double blocking, array_t* mask) {
+  uint8_t* flags = mask_flags_new(a, mask);
+  double min = dtype_max[a->dtype];
+  for(int j = 0; j < a->height; j++)
+    min = row_min(rl_array_row(a, j), blocking, mask_row_flags(mask, j, flags), min, a->dtype, a->width);
+  free(flags);
+  return min;
+}
+
+double rl_array_max(array_t* a, double blocking, array_t* mask) {
+  uint8_t* flags = mask_flags_new(a, mask);
+  double max = dtype_min[a->dtype];
+  for(int j = 0; j < a->height; j++)
+    max = row_max(rl_array_row(a, j), blocking, mask_row_flags(mask, j, flags), max, a->dtype, a->width);
+  free(flags);
+  return max;
+}
+
+// first cell of a row which has the given value and is neither blocking nor masked, or -1
+static int row_find(const void* a, double value, double blocking, const uint8_t* flags, int dtype, uint32_t n) {
+  rl_dtype_switch(dtype,
+    const T* x = a;
+    T v = rl_convert(T, value);
+    T b = rl_convert(T, blocking);
+    int has_blocking = rl_representable(T, blocking);
+    for(uint32_t i = 0; i < n; i++)
+      if(x[i] == v && (flags == NULL || flags[i]) && !(has_blocking && x[i] == b)) return i;
+  );
+  return -1;
 }
 
+// rows are reduced with the vectorized kernels, and only rows which improve the result are searched
+#define rl_array_argminmax_impl(name, row_kernel, compare, neutral) \
+  point_t rl_array_##name(array_t* a, double blocking, array_t* mask) { \
+    uint8_t* flags = mask_flags_new(a, mask); \
+    point_t result = {0, 0}; \
+    int is_found = 0; \
+    double best = neutral[a->dtype]; \
+    for(int j = 0; j < a->height; j++) { \
+      const uint8_t* row_flags = mask_row_flags(mask, j, flags); \
+      double value = row_kernel(rl_array_row(a, j), blocking, row_flags, best, a->dtype, a->width); \
+      if(is_found && !(value compare best)) continue; \
+      int x = row_find(rl_array_row(a, j), value, blocking, row_flags, a->dtype, a->width); \
+      if(x < 0) continue; \
+      best = value; \
+      result.x = x; \
+      result.y = j; \
+      is_found = 1; \
+    } \
+    free(flags); \
+    return result; \
+  }
+
+rl_array_argminmax_impl(argmin, row_min, <, dtype_max)
+rl_array_argminmax_impl(argmax, row_max, >, dtype_min)
+
 int rl_array_find_random(array_t* a, VALUE needle, int tries, int* rx, int* ry) {
   for(int i = 0; i < tries; i++) {
     int x = rl_random_next() % a->width;
     int y = rl_random_next() % a->height;
-    if(rl_array_value(a, x, y) == needle) {
+    if(rl_array_load(a, x, y) == needle) {
       *rx = x;
       *ry = y;
       return 1;
@@ -506,151 +1346,299 @@ array_t* rl_array_copy(array_t* src, array_t* mask) {
     if(src->is_view) {
       return rl_array_view(src, 0, 0, src->width, src->height);
     } else {
-      array_t *dest = rl_array_new(src->width, src->height);
-      for(int i = 0; i < src->width * src->height; i++) dest->values[i] = src->values[i];
+      array_t *dest = rl_array_new_dtype(src->width, src->height, src->dtype);
+      memcpy(dest->values, src->values, rl_dtype_size(src->dtype) * src->width * src->height);
       return dest;
     }
   } else {
     if(src->width != mask->width || src->height != mask->height)
       rl_error("size mismatch");
-    array_t* dest = rl_array_new(src->width, src->height);
-    for(int j = 0; j < src->height; j++)
-      for(int i = 0; i < src->width; i++)
-        if(mask->values[i]) rl_array_value(dest, i, j) = rl_array_value(src, i, j);
+    array_t* dest = rl_array_new_dtype(src->width, src->height, src->dtype);
+    rl_array_copy_into(src, dest, mask);
     return dest;
   }
 }
 
+array_t* rl_array_copy_bitmask(array_t* src, bitmask_t* mask) {
+  if(src->width != mask->width || src->height != mask->height)
+    rl_error("size mismatch");
+  array_t* dest = rl_array_new_dtype(src->width, src->height, src->dtype);
+  rl_array_copy_bitmask_into(src, dest, mask);
+  return dest;
+}
+
+// copies cell (i, j) if is_copied, and zeroes it if is_zeroed, converting values when dtypes differ
+#define rl_array_copy_cells(src, dest, is_copied, is_zeroed) \
+  if(src->dtype == dest->dtype) { \
+    rl_dtype_switch(src->dtype, \
+      for(int j = 0; j < src->height; j++) { \
+        T* d = rl_array_row(dest, j); \
+        const T* x = rl_array_row(src, j); \
+        for(int i = 0; i < src->width; i++) \
+          if(is_copied) d[i] = x[i]; \
+          else if(is_zeroed) d[i] = 0; \
+      }); \
+  } else { \
+    for(int j = 0; j < src->height; j++) \
+      for(int i = 0; i < src->width; i++) \
+        if(is_copied) rl_array_set_number(dest, i, j, rl_array_get_number(src, i, j)); \
+        else if(is_zeroed) rl_array_set_number(dest, i, j, 0); \
+  }
+
+static void copy_all_cells(array_t* src, array_t* dest) {
+  if(src->dtype == dest->dtype) {
+    for(int j = 0; j < src->height; j++)
+      memmove(rl_array_row(dest, j), rl_array_row(src, j), rl_dtype_size(src->dtype) * src->width);
+  } else {
+    rl_array_copy_cells(src, dest, 1, 0);
+  }
+}
+
+// unlike copy_to, cells outside of the mask are set to 0 as in a fresh copy
+void rl_array_copy_into(array_t* src, array_t* dest, array_t* mask) {
+  if(src->width != dest->width || src->height != dest->height) 
+    rl_error("size mismatch");
+  check_alias(src, dest);
+  if(mask == NULL) {
+    copy_all_cells(src, dest);
+  } else {
+    if(src->width != mask->width || src->height != mask->height)
+      rl_error("size mismatch");
+    rl_array_copy_cells(src, dest, rl_array_load(mask, i, j), 1);
+  }
+}
+
+void rl_array_copy_bitmask_into(array_t* src, array_t* dest, bitmask_t* mask) {
+  if(src->width != dest->width || src->width != mask->width || src->height != dest->height || src->height != mask->height) 
+    rl_error("size mismatch");
+  check_alias(src, dest);
+  rl_array_copy_cells(src, dest, rl_bitmask_value(mask, i, j), 1);
+}
+
+// slices can be assigned from overlapping views, as before out= existed
 void rl_array_copy_to(array_t* src, array_t* dest, array_t* mask) {
   if(mask == NULL) {
     if(src->width != dest->width || src->height != dest->height) 
       rl_error("size mismatch");
-    for(int j = 0; j < src->height; j++)
-      for(int i = 0; i < src->width; i++)
-        rl_array_value(dest, i, j) = rl_array_value(src, i, j);
+    copy_all_cells(src, dest);
   } else {
     if(src->width != dest->width || src->width != mask->width || src->height != dest->height || src->height != mask->height) 
       rl_error("size mismatch");
-    for(int j = 0; j < src->height; j++)
-      for(int i = 0; i < src->width; i++)
-        if(rl_array_value(mask, i, j)) rl_array_value(dest, i, j) = rl_array_value(src, i, j);
+    rl_array_copy_cells(src, dest, rl_array_load(mask, i, j), 0);
   }
 }
 
-void rl_array_cell_automaton(array_t* a, const char* definition, int warp) {
-  VALUE value_dead = 0;
-  VALUE value_alive = 1;
-  VALUE value_will_die = 2;
-  VALUE value_will_live = 3;
-  char* birth_states = strchr(definition, 'B');
-  char* survive_states = strchr(definition, 'S');
+void rl_array_copy_to_bitmask(array_t* src, array_t* dest, bitmask_t* mask) {
+  if(src->width != dest->width || src->width != mask->width || src->height != dest->height || src->height != mask->height) 
+    rl_error("size mismatch");
+  rl_array_copy_cells(src, dest, rl_bitmask_value(mask, i, j), 0);
+}
+
+// cellular automata work on bit-packed rows, 64 cells at a time. rules are compiled to one mask per
+// number of neighbors, all ones when that number causes a birth or a survival.
+typedef struct {
+  uint64_t birth[9], survive[9];
+} automaton_rule_t;
+
+static void automaton_parse_rule(const char* definition, automaton_rule_t* rule) {
+  const char* birth_states = strchr(definition, 'B');
+  const char* survive_states = strchr(definition, 'S');
   if(birth_states == NULL) rl_error("invalid definition, no B specified");
   if(survive_states == NULL) rl_error("invalid definition, no S specified");
-  int offset_x[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
-  int offset_y[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
-  for(int y = 0; y < a->height; y++) {
-    for(int x = 0; x < a->width; x++) {
-      int neighbors = 0;
-      for(int k = 0; k < 8; k++) {
-        int i = x + offset_x[k];
-        int j = y + offset_y[k];
-        if(warp) {
-          i %= a->width;
-          j %= a->height;
-        }
-        if(i < 0 || i >= a->width || j < 0 || j >= a->height) continue;
-        VALUE value = rl_array_value(a, i, j);
-        if(value == value_alive || value == value_will_die) neighbors++;
-      }
+  memset(rule, 0, sizeof(automaton_rule_t));
+  for(const char* c = birth_states + 1; *c >= '0' && *c <= '8'; c++) rule->birth[*c - '0'] = ~(uint64_t) 0;
+  for(const char* c = survive_states + 1; *c >= '0' && *c <= '8'; c++) rule->survive[*c - '0'] = ~(uint64_t) 0;
+}
 
-      VALUE value = rl_array_value(a, x, y);
-      if(value == value_dead) {
-        for(char* c = birth_states + 1; *c && *c >= '0' && *c <= '8'; c++)
-          if(neighbors == *c - '0') {
-            value = value_will_live;
-            break;
-          }
-      } else if(value == value_alive) {
-        int found = 0;
-        for(char* c = survive_states + 1; *c && *c >= '0' && *c <= '8'; c++)
-          if(neighbors == *c - '0') {
-            found = 1; 
-            break;
-          }
-        if(!found) value = value_will_die;
-      }
-      rl_array_value(a, x, y) = value;
+#define full_add(a, b, c, sum, carry) { \
+  uint64_t partial = (a) ^ (b); \
+  sum = partial ^ (c); \
+  carry = ((a) & (b)) | (partial & (c)); \
+}
+
+// rows have a zero word on each side, and cell i is bit i + 1 so that bits 0 and width + 1 hold the
+// neighbors across the borders. neighbors are counted with bit-sliced adders, one bit plane per binary digit.
+rl_kernel(row_automaton_step, (uint64_t* dest, const uint64_t* above, const uint64_t* row, const uint64_t* below, const uint64_t* is_free, const automaton_rule_t* rule, uint32_t n), (dest, above, row, below, is_free, rule, n), {
+  automaton_rule_t r = *rule;
+  // signed so that k - 1 reaches the padding word
+  for(int k = 0; k < (int) n; k++) {
+    uint64_t n0 = (above[k] << 1) | (above[k - 1] >> 63), n1 = above[k], n2 = (above[k] >> 1) | (above[k + 1] << 63);
+    uint64_t n3 = (row[k] << 1) | (row[k - 1] >> 63), n4 = (row[k] >> 1) | (row[k + 1] << 63);
+    uint64_t n5 = (below[k] << 1) | (below[k - 1] >> 63), n6 = below[k], n7 = (below[k] >> 1) | (below[k + 1] << 63);
+    uint64_t s0, c0, s1, c1, bit0, carry0, twos, fours;
+    full_add(n0, n1, n2, s0, c0);
+    full_add(n3, n4, n5, s1, c1);
+    full_add(s0, s1, n6 ^ n7, bit0, carry0);
+    full_add(c0, c1, n6 & n7, twos, fours);
+    uint64_t bit1 = twos ^ carry0, more_fours = twos & carry0;
+    uint64_t bit2 = fours ^ more_fours, bit3 = fours & more_fours;
+    uint64_t born = 0, survives = 0;
+    for(int count = 0; count < 9; count++) {
+      uint64_t is_count = (count & 1 ? bit0 : ~bit0) & (count & 2 ? bit1 : ~bit1) & (count & 4 ? bit2 : ~bit2) & (count & 8 ? bit3 : ~bit3);
+      born |= is_count & r.birth[count];
+      survives |= is_count & r.survive[count];
     }
+    dest[k] = is_free[k] & ((row[k] & survives) | (~row[k] & born));
   }
-  for(int y = 0; y < a->height; y++) {
-    for(int x = 0; x < a->width; x++) {
-      VALUE value = rl_array_value(a, x, y);
-      if(value == value_will_die) rl_array_value(a, x, y) = value_dead;
-      else if(value == value_will_live) rl_array_value(a, x, y) = value_alive;
+})
+
+#define automaton_row(buffer, j) ((buffer) + (size_t) pitch * (j) + 1)
+#define automaton_bit(row, i) (((row)[((i) + 1) >> 6] >> (((i) + 1) & 63)) & 1)
+#define automaton_set_bit(row, i, value) ((row)[((i) + 1) >> 6] |= (uint64_t) (value) << (((i) + 1) & 63))
+
+// fills bits 0 and width + 1 of each row, and rows 0 and height + 1, with the neighbors across the borders
+static void automaton_fill_borders(uint64_t* cells, int width, int height, int pitch, int warp) {
+  for(int j = 1; j <= height; j++) {
+    uint64_t* row = automaton_row(cells, j);
+    row[0] &= ~(uint64_t) 1;
+    row[(width + 1) >> 6] &= ~((uint64_t) 1 << ((width + 1) & 63));
+    if(warp) {
+      automaton_set_bit(row, -1, automaton_bit(row, width - 1));
+      automaton_set_bit(row, width, automaton_bit(row, 0));
     }
   }
+  size_t size = sizeof(uint64_t) * (pitch - 2);
+  if(warp) {
+    memcpy(automaton_row(cells, 0), automaton_row(cells, height), size);
+    memcpy(automaton_row(cells, height + 1), automaton_row(cells, 1), size);
+  } else {
+    memset(automaton_row(cells, 0), 0, size);
+    memset(automaton_row(cells, height + 1), 0, size);
+  }
+}
+
+// cells other than 0 and 1 are left untouched and count as dead neighbors
+void rl_array_cell_automaton(array_t* a, const char* definition, int warp, int iterations) {
+  require_int32(a);
+  automaton_rule_t rule;
+  automaton_parse_rule(definition, &rule);
+  if(iterations < 0) rl_error("number of iterations cannot be negative");
+  if(a->width == 0 || a->height == 0 || iterations == 0) return;
+  int width = a->width, height = a->height;
+  int words = (width + 2 + 63) / 64, pitch = words + 2;
+  size_t size = (size_t) pitch * (height + 2);
+  uint64_t* current = calloc(size, sizeof(uint64_t));
+  uint64_t* next = calloc(size, sizeof(uint64_t));
+  uint64_t* is_free = calloc(size, sizeof(uint64_t));
+  for(int j = 0; j < height; j++) {
+    uint64_t* row = automaton_row(current, j + 1);
+    uint64_t* free_row = automaton_row(is_free, j + 1);
+    for(int i = 0; i < width; i++) {
+      VALUE value = rl_array_value(a, i, j);
+      automaton_set_bit(row, i, value == 1);
+      automaton_set_bit(free_row, i, value == 0 || value == 1);
+    }
+  }
+  // generations alternate between the two buffers
+  for(int step = 0; step < iterations; step++) {
+    automaton_fill_borders(current, width, height, pitch, warp);
+    for(int j = 1; j <= height; j++)
+      row_automaton_step(automaton_row(next, j), automaton_row(current, j - 1), automaton_row(current, j), automaton_row(current, j + 1), automaton_row(is_free, j), &rule, words);
+    uint64_t* swap = current;
+    current = next;
+    next = swap;
+  }
+  for(int j = 0; j < height; j++) {
+    const uint64_t* row = automaton_row(current, j + 1);
+    const uint64_t* free_row = automaton_row(is_free, j + 1);
+    for(int i = 0; i < width; i++)
+      if(automaton_bit(free_row, i)) rl_array_value(a, i, j) = automaton_bit(row, i);
+  }
+  free(is_free);
+  free(next);
+  free(current);
+}
+
+// operands of element-wise operations have the same size and dtype
+static void check_operands(array_t* a, array_t* b, int is_int_only) {
+  if(a->width != b->width || a->height != b->height) rl_error("size mismatch");
+  if(a->dtype != b->dtype) rl_error("dtype mismatch");
+  if(is_int_only && a->dtype == DTYPE_FLOAT32) rl_error("operator not supported on float32 arrays");
 }
 
-#define rl_array_right_op_value(name, operator) \
-  array_t* rl_array_right_##name##_value(array_t* a, VALUE value) { \
-    array_t *b = rl_array_new(a->width, a->height); \
+#define rl_array_right_op_value(name, is_int_only) \
+  void rl_array_right_##name##_value_into(array_t* a, array_t* result, double value) { \
+    check_operands(a, result, is_int_only); \
+    check_alias(a, result); \
     for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(b, i, j) = (rl_array_value(a, i, j) operator value); \
+      row_right_##name##_value(rl_array_row(result, j), rl_array_row(a, j), value, a->dtype, a->width); \
+  } \
+  array_t* rl_array_right_##name##_value(array_t* a, double value) { \
+    array_t *b = rl_array_new_dtype(a->width, a->height, a->dtype); \
+    rl_array_right_##name##_value_into(a, b, value); \
     return b; \
   }
 
-#define rl_array_right_op_other(name, operator) \
-  array_t* rl_array_right_##name##_other(array_t* a, array_t* other) { \
-    if(a->width != other->width || a->height != other->height) rl_error("size mismatch"); \
-    array_t *b = rl_array_new(a->width, a->height); \
+#define rl_array_right_op_other(name, is_int_only) \
+  void rl_array_right_##name##_other_into(array_t* a, array_t* result, array_t* other) { \
+    check_operands(a, other, is_int_only); \
+    check_operands(a, result, is_int_only); \
+    check_alias(a, result); \
+    check_alias(other, result); \
     for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(b, i, j) = (rl_array_value(a, i, j) operator rl_array_value(other, i, j)); \
+      row_##name##_other(rl_array_row(result, j), rl_array_row(a, j), rl_array_row(other, j), a->dtype, a->width); \
+  } \
+  array_t* rl_array_right_##name##_other(array_t* a, array_t* other) { \
+    check_operands(a, other, is_int_only); \
+    array_t *b = rl_array_new_dtype(a->width, a->height, a->dtype); \
+    rl_array_right_##name##_other_into(a, b, other); \
     return b; \
   }
 
-#define rl_array_inplace_op_value(name, operator) \
-  void rl_array_inplace_##name##_value(array_t* a, VALUE value) { \
-    for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(a, i, j) = (rl_array_value(a, i, j) operator value); \
+#define rl_array_inplace_op_value(name) \
+  void rl_array_inplace_##name##_value(array_t* a, double value) { \
+    rl_array_right_##name##_value_into(a, a, value); \
   }
 
-#define rl_array_inplace_op_other(name, operator) \
-  void rl_array_inplace_##name##_other(array_t* other, array_t* a) { \
-    if(a->width != other->width || a->height != other->height) rl_error("size mismatch"); \
+// in-place operators accept any other operand, rows are updated from top to bottom
+#define rl_array_inplace_op_other(name, is_int_only) \
+  void rl_array_inplace_##name##_other(array_t* a, array_t* other) { \
+    check_operands(a, other, is_int_only); \
     for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(a, i, j) = (rl_array_value(a, i, j) operator rl_array_value(other, i, j)); \
+      row_##name##_other(rl_array_row(a, j), rl_array_row(a, j), rl_array_row(other, j), a->dtype, a->width); \
   }
 
-#define rl_array_left_op_value(name, operator) \
-  array_t* rl_array_left_##name##_value(array_t* a, VALUE value) { \
-    array_t *b = rl_array_new(a->width, a->height); \
+#define rl_array_left_op_value(name, is_int_only) \
+  void rl_array_left_##name##_value_into(array_t* a, array_t* result, double value) { \
+    check_operands(a, result, is_int_only); \
+    check_alias(a, result); \
     for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(b, i, j) = (value operator rl_array_value(a, i, j)); \
+      row_left_##name##_value(rl_array_row(result, j), rl_array_row(a, j), value, a->dtype, a->width); \
+  } \
+  array_t* rl_array_left_##name##_value(array_t* a, double value) { \
+    array_t *b = rl_array_new_dtype(a->width, a->height, a->dtype); \
+    rl_array_left_##name##_value_into(a, b, value); \
     return b; \
   }
 
-#define rl_array_left_op_other(name, operator) \
-  array_t* rl_array_left_##name##_other(array_t* other, array_t* a) { \
-    if(a->width != other->width || a->height != other->height) rl_error("size mismatch"); \
-    array_t *b = rl_array_new(a->width, a->height); \
+#define rl_array_left_op_other(name, is_int_only) \
+  void rl_array_left_##name##_other_into(array_t* other, array_t* result, array_t* a) { \
+    check_operands(a, other, is_int_only); \
+    check_operands(a, result, is_int_only); \
+    check_alias(a, result); \
+    check_alias(other, result); \
     for(int j = 0; j < a->height; j++) \
-      for(int i = 0; i < a->width; i++) \
-        rl_array_value(b, i, j) = (rl_array_value(other, i, j) operator rl_array_value(a, i, j)); \
+      row_##name##_other(rl_array_row(result, j), rl_array_row(other, j), rl_array_row(a, j), a->dtype, a->width); \
+  } \
+  array_t* rl_array_left_##name##_other(array_t* other, array_t* a) { \
+    check_operands(a, other, is_int_only); \
+    array_t *b = rl_array_new_dtype(a->width, a->height, a->dtype); \
+    rl_array_left_##name##_other_into(other, b, a); \
     return b; \
   }
 
-#define rl_array_op_impl(name, operator) \
-  rl_array_left_op_value(name, operator); \
-  rl_array_left_op_other(name, operator); \
-  rl_array_right_op_value(name, operator); \
-  rl_array_right_op_other(name, operator); \
-  rl_array_inplace_op_value(name, operator); \
-  rl_array_inplace_op_other(name, operator);
+#define rl_array_op_impl_switch(name, operator, dtype_switch, is_int_only) \
+  rl_row_op_kernels(name, operator, dtype_switch) \
+  rl_array_left_op_value(name, is_int_only); \
+  rl_array_left_op_other(name, is_int_only); \
+  rl_array_right_op_value(name, is_int_only); \
+  rl_array_right_op_other(name, is_int_only); \
+  rl_array_inplace_op_value(name); \
+  rl_array_inplace_op_other(name, is_int_only);
+
+#define rl_array_op_impl(name, operator) rl_array_op_impl_switch(name, operator, rl_dtype_switch, 0)
+// bitwise operators and modulo have no float32 version
+#define rl_array_int_op_impl(name, operator) rl_array_op_impl_switch(name, operator, rl_int_dtype_switch, 1)
 
 rl_array_op_impl(equal, ==);
 rl_array_op_impl(greater_than, >);
@@ -658,150 +1646,1333 @@ rl_array_op_impl(less_than, <);
 rl_array_op_impl(greater_or_equal_than, >=);
 rl_array_op_impl(less_or_equal_than, <=);
 rl_array_op_impl(not_equal, !=);
-rl_array_op_impl(and, &);
-rl_array_op_impl(or, |);
-rl_array_op_impl(xor, ^);
-rl_array_op_impl(lshift, <<);
-rl_array_op_impl(rshift, >>);
+rl_array_int_op_impl(and, &);
+rl_array_int_op_impl(or, |);
+rl_array_int_op_impl(xor, ^);
+rl_array_int_op_impl(lshift, <<);
+rl_array_int_op_impl(rshift, >>);
 rl_array_op_impl(add, +);
 rl_array_op_impl(sub, -);
 rl_array_op_impl(mul, *);
 rl_array_op_impl(div, /);
-rl_array_op_impl(mod, %);
-
-array_t* rl_array_unary_minus(array_t* a) {
-  array_t *b = rl_array_new(a->width, a->height);
-  for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      rl_array_value(b, i, j) = -rl_array_value(a, i, j);
-  return b;
-}
+rl_array_int_op_impl(mod, %);
 
-array_t* rl_array_unary_not(array_t* a) {
-  array_t *b = rl_array_new(a->width, a->height);
-  for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      rl_array_value(b, i, j) = !rl_array_value(a, i, j);
-  return b;
-}
+#define rl_array_unary_impl(name, kernel, is_int_only) \
+  void rl_array_##name##_into(array_t* a, array_t* result) { \
+    check_operands(a, result, is_int_only); \
+    check_alias(a, result); \
+    for(int j = 0; j < a->height; j++) \
+      kernel(rl_array_row(result, j), rl_array_row(a, j), a->dtype, a->width); \
+  } \
+  array_t* rl_array_##name(array_t* a) { \
+    if(is_int_only && a->dtype == DTYPE_FLOAT32) rl_error("operator not supported on float32 arrays"); \
+    array_t *b = rl_array_new_dtype(a->width, a->height, a->dtype); \
+    rl_array_##name##_into(a, b); \
+    return b; \
+  }
 
-array_t* rl_array_unary_invert(array_t* a) {
-  array_t *b = rl_array_new(a->width, a->height);
-  for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      rl_array_value(b, i, j) = ~rl_array_value(a, i, j);
-  return b;
-}
+rl_array_unary_impl(unary_minus, row_minus, 0)
+rl_array_unary_impl(unary_not, row_not, 0)
+rl_array_unary_impl(unary_invert, row_invert, 1)
 
-int rl_array_any_equals(array_t* a, VALUE value) {
+int rl_array_any_equals(array_t* a, double value) {
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      if(rl_array_value(a, i, j) == value) return 1;
+    if(row_count(rl_array_row(a, j), value, NULL, a->dtype, a->width) > 0) return 1;
   return 0;
 }
 
-int rl_array_all_equal(array_t* a, VALUE value) {
+int rl_array_all_equal(array_t* a, double value) {
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      if(rl_array_value(a, i, j) != value) return 0;
+    if(row_count(rl_array_row(a, j), value, NULL, a->dtype, a->width) != a->width) return 0;
   return 1;
 }
 
-int rl_array_count(array_t* a, VALUE value) {
+int rl_array_count(array_t* a, double value, array_t* mask) {
+  uint8_t* flags = mask_flags_new(a, mask);
   int num = 0;
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      if(rl_array_value(a, i, j) == value) num++;
+    num += row_count(rl_array_row(a, j), value, mask_row_flags(mask, j, flags), a->dtype, a->width);
+  free(flags);
   return num;
 }
 
-uint64_t rl_array_sum(array_t* a) {
-  uint64_t sum = 0;
+double rl_array_sum(array_t* a, array_t* mask) {
+  uint8_t* flags = mask_flags_new(a, mask);
+  double sum = 0;
   for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++)
-      sum += rl_array_value(a, i, j);
+    sum += row_sum(rl_array_row(a, j), mask_row_flags(mask, j, flags), a->dtype, a->width);
+  free(flags);
   return sum;
 }
 
-array_t* rl_array_abs(array_t* a) {
-  array_t* b = rl_array_new(a->width, a->height);
-  for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < a->width; i++) {
-      VALUE value = rl_array_value(a, i, j);
-      rl_array_value(b, i, j) = (value > 0 ? value : -value);
+// reduction of each column into a row of accumulators
+rl_kernel(row_accumulate, (double* acc, const void* a, int op, double blocking, const uint8_t* flags, int dtype, uint32_t n), (acc, a, op, blocking, flags, dtype, n), {
+  rl_dtype_switch(dtype,
+    const T* x = a;
+    T b = rl_convert(T, blocking);
+    int has_blocking = op != REDUCE_SUM && rl_representable(T, blocking);
+    for(uint32_t i = 0; i < n; i++) {
+      int is_included = (flags == NULL || flags[i]) && !(has_blocking && x[i] == b);
+      double value = x[i];
+      if(op == REDUCE_SUM) acc[i] += is_included ? value : 0;
+      else if(op == REDUCE_MIN) acc[i] = is_included && value < acc[i] ? value : acc[i];
+      else acc[i] = is_included && value > acc[i] ? value : acc[i];
+    });
+})
+
+// axis 0 reduces each row into a 1 x height result, axis 1 each column into a width x 1 result
+void rl_array_reduce_axis_into(array_t* a, array_t* result, int op, int axis, double blocking, array_t* mask) {
+  if(op != REDUCE_SUM && op != REDUCE_MIN && op != REDUCE_MAX) rl_error("invalid reduction %d", op);
+  if(axis != 0 && axis != 1) rl_error("invalid axis %d", axis);
+  if(axis == 0 ? result->width != 1 || result->height != a->height : result->width != a->width || result->height != 1) rl_error("size mismatch");
+  if(arrays_overlap(a, result)) rl_error("result cannot overlap operands");
+  uint8_t* flags = mask_flags_new(a, mask);
+  double initial = op == REDUCE_MIN ? dtype_max[a->dtype] : op == REDUCE_MAX ? dtype_min[a->dtype] : 0;
+  if(axis == 0) {
+    for(int j = 0; j < a->height; j++) {
+      const void* row = rl_array_row(a, j);
+      const uint8_t* row_flags = mask_row_flags(mask, j, flags);
+      double value = op == REDUCE_SUM ? row_sum(row, row_flags, a->dtype, a->width)
+        : op == REDUCE_MIN ? row_min(row, blocking, row_flags, initial, a->dtype, a->width)
+        : row_max(row, blocking, row_flags, initial, a->dtype, a->width);
+      rl_array_set_number(result, 0, j, value);
     }
-  return b;
+  } else {
+    double* acc = malloc(sizeof(double) * (a->width > 0 ? a->width : 1));
+    for(int i = 0; i < a->width; i++) acc[i] = initial;
+    for(int j = 0; j < a->height; j++)
+      row_accumulate(acc, rl_array_row(a, j), op, blocking, mask_row_flags(mask, j, flags), a->dtype, a->width);
+    for(int i = 0; i < a->width; i++) rl_array_set_number(result, i, 0, acc[i]);
+    free(acc);
+  }
+  free(flags);
+}
+
+// counts[v] receives the number of cells with value v, for v in [0, bins). other values are not counted
+void rl_array_histogram(array_t* a, int bins, uint32_t* counts, array_t* mask) {
+  if(a->dtype == DTYPE_FLOAT32) rl_error("integer array expected");
+  uint8_t* flags = mask_flags_new(a, mask);
+  memset(counts, 0, sizeof(uint32_t) * bins);
+  for(int j = 0; j < a->height; j++) {
+    const uint8_t* row_flags = mask_row_flags(mask, j, flags);
+    rl_int_dtype_switch(a->dtype,
+      const T* x = rl_array_row(a, j);
+      for(int i = 0; i < a->width; i++) {
+        uint32_t value = (uint32_t) (int32_t) x[i];
+        if(value < (uint32_t) bins && (row_flags == NULL || row_flags[i])) counts[value]++;
+      });
+  }
+  free(flags);
+}
+
+static int compare_floats(const void* a, const void* b) {
+  float x = *(const float*) a, y = *(const float*) b;
+  return (x > y) - (x < y);
+}
+
+static int compare_values(const void* a, const void* b) {
+  VALUE x = *(const VALUE*) a, y = *(const VALUE*) b;
+  return (x > y) - (x < y);
+}
+
+// integer values are counted in a table over their range when it is small enough, other values are sorted
+#define UNIQUE_MAX_TABLE_SIZE (1 << 20)
+
+value_counts_t* rl_array_unique(array_t* a, array_t* mask) {
+  value_counts_t* result;
+  // 0.5 is never equal to integer cells, none of them are blocking
+  double min = 0, max = -1;
+  if(a->dtype != DTYPE_FLOAT32) {
+    min = rl_array_min(a, 0.5, mask);
+    max = rl_array_max(a, 0.5, mask);
+  }
+  if(max >= min && max - min < UNIQUE_MAX_TABLE_SIZE) {
+    // the histogram of values shifted by min
+    int bins = (int) (max - min) + 1;
+    uint32_t* counts = calloc(bins, sizeof(uint32_t));
+    uint8_t* flags = mask_flags_new(a, mask);
+    for(int j = 0; j < a->height; j++) {
+      const uint8_t* row_flags = mask_row_flags(mask, j, flags);
+      rl_int_dtype_switch(a->dtype,
+        const T* x = rl_array_row(a, j);
+        int offset = (int) min;
+        if(row_flags == NULL) for(int i = 0; i < a->width; i++) counts[x[i] - offset]++;
+        else for(int i = 0; i < a->width; i++) if(row_flags[i]) counts[x[i] - offset]++);
+    }
+    free(flags);
+    int size = 0;
+    for(int i = 0; i < bins; i++) size += counts[i] != 0;
+    result = malloc(sizeof(value_counts_t) + sizeof(value_count_t) * (size == 0 ? 0 : size - 1));
+    result->size = 0;
+    for(int i = 0; i < bins; i++) {
+      if(counts[i] == 0) continue;
+      result->values[result->size].value = min + i;
+      result->values[result->size].count = counts[i];
+      result->size++;
+    }
+    free(counts);
+    return result;
+  }
+  // included cells are gathered as int32 or float32 and sorted
+  int elem_size = a->dtype == DTYPE_FLOAT32 ? sizeof(float) : sizeof(VALUE);
+  char* values = malloc((size_t) elem_size * (a->width * a->height > 0 ? a->width * a->height : 1));
+  uint8_t* flags = mask_flags_new(a, mask);
+  size_t num = 0;
+  for(int j = 0; j < a->height; j++) {
+    const uint8_t* row_flags = mask_row_flags(mask, j, flags);
+    rl_dtype_switch(a->dtype,
+      const T* x = rl_array_row(a, j);
+      for(int i = 0; i < a->width; i++) {
+        if(row_flags != NULL && !row_flags[i]) continue;
+        if(a->dtype == DTYPE_FLOAT32) ((float*) values)[num++] = x[i];
+        else ((VALUE*) values)[num++] = x[i];
+      });
+  }
+  free(flags);
+  qsort(values, num, elem_size, a->dtype == DTYPE_FLOAT32 ? compare_floats : compare_values);
+  #define unique_value(k) (a->dtype == DTYPE_FLOAT32 ? (double) ((float*) values)[k] : (double) ((VALUE*) values)[k])
+  int size = 0;
+  for(size_t k = 0; k < num; k++) size += k == 0 || unique_value(k) != unique_value(k - 1);
+  result = malloc(sizeof(value_counts_t) + sizeof(value_count_t) * (size == 0 ? 0 : size - 1));
+  result->size = 0;
+  for(size_t k = 0; k < num; k++) {
+    if(k == 0 || unique_value(k) != unique_value(k - 1)) {
+      result->values[result->size].value = unique_value(k);
+      result->values[result->size].count = 0;
+      result->size++;
+    }
+    result->values[result->size - 1].count++;
+  }
+  #undef unique_value
+  free(values);
+  return result;
+}
+
+rl_array_unary_impl(abs, row_abs, 0)
+
+/* fused expressions */
+
+typedef void (*row_other_kernel_t)(void* dest, const void* a, const void* b, int dtype, uint32_t n);
+typedef void (*row_value_kernel_t)(void* dest, const void* a, double value, int dtype, uint32_t n);
+typedef void (*row_unary_kernel_t)(void* dest, const void* a, int dtype, uint32_t n);
+
+#define rl_expr_kernels(prefix, suffix) { \
+  prefix##equal##suffix, prefix##greater_than##suffix, prefix##less_than##suffix, \
+  prefix##greater_or_equal_than##suffix, prefix##less_or_equal_than##suffix, prefix##not_equal##suffix, \
+  prefix##and##suffix, prefix##or##suffix, prefix##xor##suffix, prefix##lshift##suffix, prefix##rshift##suffix, \
+  prefix##add##suffix, prefix##sub##suffix, prefix##mul##suffix, prefix##div##suffix, prefix##mod##suffix }
+
+// indexed by op - EXPR_EQUAL and op - EXPR_MINUS
+static const row_other_kernel_t expr_other_kernels[] = rl_expr_kernels(row_, _other);
+static const row_value_kernel_t expr_left_value_kernels[] = rl_expr_kernels(row_left_, _value);
+static const row_value_kernel_t expr_right_value_kernels[] = rl_expr_kernels(row_right_, _value);
+static const row_unary_kernel_t expr_unary_kernels[] = { row_minus, row_not, row_invert, row_abs };
+
+expr_t* rl_expr_array(array_t* a) {
+  expr_t* e = rl_malloc(sizeof(expr_t));
+  memset(e, 0, sizeof(expr_t));
+  e->op = EXPR_ARRAY;
+  e->array = a;
+  return e;
+}
+
+expr_t* rl_expr_value(double value) {
+  expr_t* e = rl_malloc(sizeof(expr_t));
+  memset(e, 0, sizeof(expr_t));
+  e->op = EXPR_VALUE;
+  e->value = value;
+  return e;
+}
+
+expr_t* rl_expr_binary(int op, expr_t* left, expr_t* right) {
+  if(!EXPR_IS_BINARY(op)) rl_error("invalid binary operator %d", op);
+  expr_t* e = rl_malloc(sizeof(expr_t));
+  memset(e, 0, sizeof(expr_t));
+  e->op = op;
+  e->left = left;
+  e->right = right;
+  return e;
+}
+
+expr_t* rl_expr_unary(int op, expr_t* operand) {
+  if(!EXPR_IS_UNARY(op)) rl_error("invalid unary operator %d", op);
+  expr_t* e = rl_malloc(sizeof(expr_t));
+  memset(e, 0, sizeof(expr_t));
+  e->op = op;
+  e->left = operand;
+  return e;
+}
+
+// the tree is flattened to a postfix program, sub-expressions without arrays are folded to constants
+enum { EXPR_INSN_ARRAY, EXPR_INSN_OTHER, EXPR_INSN_LEFT_VALUE, EXPR_INSN_RIGHT_VALUE, EXPR_INSN_UNARY };
+
+typedef struct {
+  int kind, op;
+  double value;
+  array_t* array;
+} expr_insn_t;
+
+typedef struct {
+  expr_insn_t* insns;
+  int size, depth, max_depth;
+} expr_program_t;
+
+#define EXPR_CHUNK 256
+
+static VALUE expr_apply_int(int op, VALUE a, VALUE b) {
+  switch(op) {
+    case EXPR_EQUAL: return a == b;
+    case EXPR_GREATER_THAN: return a > b;
+    case EXPR_LESS_THAN: return a < b;
+    case EXPR_GREATER_OR_EQUAL_THAN: return a >= b;
+    case EXPR_LESS_OR_EQUAL_THAN: return a <= b;
+    case EXPR_NOT_EQUAL: return a != b;
+    case EXPR_AND: return a & b;
+    case EXPR_OR: return a | b;
+    case EXPR_XOR: return a ^ b;
+    case EXPR_LSHIFT: return a << b;
+    case EXPR_RSHIFT: return a >> b;
+    case EXPR_ADD: return a + b;
+    case EXPR_SUB: return a - b;
+    case EXPR_MUL: return a * b;
+    case EXPR_DIV: return a / b;
+    case EXPR_MOD: return a % b;
+    case EXPR_MINUS: return -a;
+    case EXPR_NOT: return !a;
+    case EXPR_INVERT: return ~a;
+    case EXPR_ABS: return a > 0 ? a : -a;
+  }
+  return 0;
+}
+
+// constants are folded with the arithmetic of the destination, integer operators never reach the float case
+static double expr_apply(int op, double a, double b, int dtype) {
+  if(dtype != DTYPE_FLOAT32) return expr_apply_int(op, (VALUE) a, (VALUE) b);
+  float x = a, y = b;
+  switch(op) {
+    case EXPR_EQUAL: return x == y;
+    case EXPR_GREATER_THAN: return x > y;
+    case EXPR_LESS_THAN: return x < y;
+    case EXPR_GREATER_OR_EQUAL_THAN: return x >= y;
+    case EXPR_LESS_OR_EQUAL_THAN: return x <= y;
+    case EXPR_NOT_EQUAL: return x != y;
+    case EXPR_ADD: return x + y;
+    case EXPR_SUB: return x - y;
+    case EXPR_MUL: return x * y;
+    case EXPR_DIV: return x / y;
+    case EXPR_MINUS: return -x;
+    case EXPR_NOT: return !x;
+    case EXPR_ABS: return x > 0 ? x : -x;
+  }
+  return 0;
+}
+
+// checks the tree before anything is allocated and returns the number of nodes
+static int expr_check(expr_t* e, array_t* dest) {
+  if(e == NULL) rl_error("incomplete expression");
+  if(e->op == EXPR_ARRAY) {
+    check_operands(e->array, dest, 0);
+    check_alias(e->array, dest);
+    return 1;
+  }
+  if(e->op == EXPR_VALUE) return 1;
+  int is_int_only = e->op == EXPR_INVERT || e->op == EXPR_MOD || (e->op >= EXPR_AND && e->op <= EXPR_RSHIFT);
+  if(is_int_only && dest->dtype == DTYPE_FLOAT32) rl_error("operator not supported on float32 arrays");
+  if(EXPR_IS_UNARY(e->op)) return 1 + expr_check(e->left, dest);
+  if(!EXPR_IS_BINARY(e->op)) rl_error("invalid operator %d", e->op);
+  return 1 + expr_check(e->left, dest) + expr_check(e->right, dest);
+}
+
+static void expr_emit(expr_program_t* p, int kind, int op, double value, array_t* array) {
+  expr_insn_t* insn = &p->insns[p->size++];
+  insn->kind = kind;
+  insn->op = op;
+  insn->value = value;
+  insn->array = array;
+  if(kind == EXPR_INSN_ARRAY) p->depth++;
+  else if(kind == EXPR_INSN_OTHER) p->depth--;
+  if(p->depth > p->max_depth) p->max_depth = p->depth;
+}
+
+// returns 1 and sets constant when the sub-expression does not depend on arrays
+// integer division by a constant zero is reported in divide_by_zero so that scratch memory can be released first
+static int expr_compile(expr_t* e, expr_program_t* p, int dtype, double* constant, int* divide_by_zero) {
+  if(e->op == EXPR_VALUE) {
+    *constant = e->value;
+    return 1;
+  }
+  if(e->op == EXPR_ARRAY) {
+    expr_emit(p, EXPR_INSN_ARRAY, 0, 0, e->array);
+    return 0;
+  }
+  if(EXPR_IS_UNARY(e->op)) {
+    double value;
+    if(expr_compile(e->left, p, dtype, &value, divide_by_zero)) {
+      *constant = expr_apply(e->op, value, 0, dtype);
+      return 1;
+    }
+    expr_emit(p, EXPR_INSN_UNARY, e->op, 0, NULL);
+    return 0;
+  }
+  double left, right;
+  int left_is_constant = expr_compile(e->left, p, dtype, &left, divide_by_zero);
+  int right_is_constant = expr_compile(e->right, p, dtype, &right, divide_by_zero);
+  if(right_is_constant && (VALUE) right == 0 && dtype != DTYPE_FLOAT32 && (e->op == EXPR_DIV || e->op == EXPR_MOD)) {
+    *divide_by_zero = 1;
+    right = 1;
+  }
+  if(left_is_constant && right_is_constant) {
+    *constant = expr_apply(e->op, left, right, dtype);
+    return 1;
+  }
+  if(left_is_constant) expr_emit(p, EXPR_INSN_LEFT_VALUE, e->op, left, NULL);
+  else if(right_is_constant) expr_emit(p, EXPR_INSN_RIGHT_VALUE, e->op, right, NULL);
+  else expr_emit(p, EXPR_INSN_OTHER, e->op, 0, NULL);
+  return 0;
+}
+
+// the last instruction writes to dest, which may be one of the operands since all operators are element-wise
+void rl_expr_eval_into(expr_t* e, array_t* dest) {
+  int num_nodes = expr_check(e, dest);
+  expr_program_t p = {malloc(sizeof(expr_insn_t) * num_nodes), 0, 0, 0};
+  double constant;
+  int divide_by_zero = 0;
+  int is_constant = expr_compile(e, &p, dest->dtype, &constant, &divide_by_zero);
+  if(divide_by_zero) {
+    free(p.insns);
+    rl_error("division by zero");
+  }
+  if(is_constant) {
+    free(p.insns);
+    rl_array_fill(dest, constant);
+    return;
+  }
+
+  // one chunk of scratch per stack slot, arrays are read in place
+  int dtype = dest->dtype;
+  size_t size = rl_dtype_size(dtype);
+  char* scratch = malloc(size * EXPR_CHUNK * p.max_depth);
+  const void** stack = malloc(sizeof(void*) * p.max_depth);
+  for(int j = 0; j < dest->height; j++) {
+    for(uint32_t x = 0; x < dest->width; x += EXPR_CHUNK) {
+      uint32_t n = dest->width - x < EXPR_CHUNK ? dest->width - x : EXPR_CHUNK;
+      void* dest_chunk = rl_array_cell(dest, x, j);
+      int top = -1;
+      for(int k = 0; k < p.size; k++) {
+        expr_insn_t* insn = &p.insns[k];
+        if(insn->kind == EXPR_INSN_ARRAY) {
+          stack[++top] = rl_array_cell(insn->array, x, j);
+          continue;
+        }
+        if(insn->kind == EXPR_INSN_OTHER) top--;
+        void* out = k == p.size - 1 ? dest_chunk : scratch + size * EXPR_CHUNK * top;
+        switch(insn->kind) {
+          case EXPR_INSN_OTHER: expr_other_kernels[insn->op - EXPR_EQUAL](out, stack[top], stack[top + 1], dtype, n); break;
+          case EXPR_INSN_LEFT_VALUE: expr_left_value_kernels[insn->op - EXPR_EQUAL](out, stack[top], insn->value, dtype, n); break;
+          case EXPR_INSN_RIGHT_VALUE: expr_right_value_kernels[insn->op - EXPR_EQUAL](out, stack[top], insn->value, dtype, n); break;
+          case EXPR_INSN_UNARY: expr_unary_kernels[insn->op - EXPR_MINUS](out, stack[top], dtype, n); break;
+        }
+        stack[top] = out;
+      }
+      // a bare array is copied
+      if(p.size == 1 && stack[0] != dest_chunk) memmove(dest_chunk, stack[0], size * n);
+    }
+  }
+  free(stack);
+  free(scratch);
+  free(p.insns);
+}
+
+static array_t* expr_find_array(expr_t* e) {
+  if(e == NULL || e->op == EXPR_VALUE) return NULL;
+  if(e->op == EXPR_ARRAY) return e->array;
+  array_t* a = expr_find_array(e->left);
+  return a != NULL ? a : expr_find_array(e->right);
+}
+
+// the size of the result comes from the first array in the expression
+array_t* rl_expr_eval(expr_t* e) {
+  array_t* a = expr_find_array(e);
+  if(a == NULL) rl_error("expression does not contain arrays");
+  array_t* result = rl_array_new_dtype(a->width, a->height, a->dtype);
+  rl_expr_eval_into(e, result);
+  return result;
+}
+
+// matrix products accumulate rows of b scaled by cells of a into rows of the result (i-k-j order), so
+// that all accesses are contiguous. blocks of columns and of rows of b are processed in turn, to keep
+// the part of b in use in cache. arithmetic wraps around like int32 multiplications and additions.
+#define MATMUL_BLOCK_WIDTH 1024
+#define MATMUL_BLOCK_DEPTH 64
+
+rl_kernel(row_multiply_add32, (uint32_t* restrict acc, const uint32_t* restrict b, uint32_t value, uint32_t n), (acc, b, value, n), {
+  for(uint32_t i = 0; i < n; i++) acc[i] += b[i] * value;
+})
+
+void rl_array_matmul_into(array_t* a, array_t* result, array_t* b) {
+  if(a->width != b->height) rl_error("size mismatch %d != %d", a->width, b->height);
+  if(result->width != b->width || result->height != a->height) rl_error("size mismatch");
+  require_int32(a);
+  require_int32(b);
+  require_int32(result);
+  if(arrays_overlap(a, result) || arrays_overlap(b, result)) rl_error("result cannot overlap operands");
+  for(uint32_t j = 0; j < result->height; j++) memset(rl_array_row(result, j), 0, sizeof(VALUE) * result->width);
+  for(uint32_t i0 = 0; i0 < b->width; i0 += MATMUL_BLOCK_WIDTH) {
+    uint32_t width = b->width - i0 < MATMUL_BLOCK_WIDTH ? b->width - i0 : MATMUL_BLOCK_WIDTH;
+    for(uint32_t k0 = 0; k0 < a->width; k0 += MATMUL_BLOCK_DEPTH) {
+      uint32_t k1 = a->width - k0 < MATMUL_BLOCK_DEPTH ? a->width : k0 + MATMUL_BLOCK_DEPTH;
+      for(uint32_t j = 0; j < a->height; j++) {
+        uint32_t* acc = (uint32_t*) &rl_array_value(result, i0, j);
+        for(uint32_t k = k0; k < k1; k++) {
+          uint32_t value = rl_array_value(a, k, j);
+          if(value != 0) row_multiply_add32(acc, (const uint32_t*) &rl_array_value(b, i0, k), value, width);
+        }
+      }
+    }
+  }
 }
 
-// TODO: need a way to normalize for range of uint32_t
 array_t* rl_array_matmul(array_t* a, array_t* b) {
   if(a->width != b->height) rl_error("size mismatch %d != %d", a->width, b->height);
   array_t* c = rl_array_new(b->width, a->height);
-  for(int j = 0; j < a->height; j++)
-    for(int i = 0; i < b->width; i++) {
-      uint64_t sum = 0; 
-      for(int k = 0; k < a->width; k++) 
-        sum += rl_array_value(a, k, j) * rl_array_value(b, i, k);
-      rl_array_value(c, i, j) = (VALUE) sum;
+  rl_array_matmul_into(a, c, b);
+  return c;
+}
+
+// convolution: each tap of the kernel is added to a whole row of accumulators, over the range of cells
+// for which it falls inside the array. results are exact, sums are int64 and cells are divided by the
+// sum of absolute values of the taps that were used, like the direct per-cell formula.
+
+rl_kernel(row_multiply_add, (int64_t* acc, const VALUE* a, VALUE value, uint32_t n), (acc, a, value, n), {
+  for(uint32_t i = 0; i < n; i++) acc[i] += (int64_t) a[i] * value;
+})
+
+rl_kernel(row_multiply_add64, (int64_t* acc, const int64_t* a, int64_t value, uint32_t n), (acc, a, value, n), {
+  for(uint32_t i = 0; i < n; i++) acc[i] += a[i] * value;
+})
+
+// range of cells i for which i + offset is inside [0, size)
+static inline void kernel_tap_range(int offset, int size, int* start, int* end) {
+  *start = offset < 0 ? -offset : 0;
+  *end = offset > 0 ? size - offset : size;
+  if(*end < *start) *end = *start;
+}
+
+static void kernel_store_row(array_t* result, int j, const int64_t* sum, const int64_t* num) {
+  VALUE* dest = &rl_array_value(result, 0, j);
+  for(int i = 0; i < result->width; i++) dest[i] = num[i] != 0 ? sum[i] / num[i] : 0;
+}
+
+// kernels of a single repeated value are box filters, computed from a summed-area table in constant time per cell
+static int kernel_is_box(array_t* kernel, VALUE* value) {
+  if(kernel->width == 0 || kernel->height == 0) return 0;
+  *value = rl_array_value(kernel, 0, 0);
+  if(*value == 0) return 0;
+  for(int j = 0; j < kernel->height; j++)
+    for(int i = 0; i < kernel->width; i++)
+      if(rl_array_value(kernel, i, j) != *value) return 0;
+  return 1;
+}
+
+static void apply_kernel_box(array_t* a, array_t* result, array_t* kernel, VALUE value) {
+  int w = a->width, h = a->height;
+  int64_t* table = malloc(sizeof(int64_t) * (w + 1) * (h + 1));
+  memset(table, 0, sizeof(int64_t) * (w + 1));
+  for(int j = 0; j < h; j++) {
+    const VALUE* row = &rl_array_value(a, 0, j);
+    int64_t* above = table + (size_t) (w + 1) * j;
+    int64_t* current = above + w + 1;
+    int64_t row_sum = 0;
+    current[0] = 0;
+    for(int i = 0; i < w; i++) {
+      row_sum += row[i];
+      current[i + 1] = above[i + 1] + row_sum;
+    }
+  }
+  // value * sum / (|value| * count) truncates like sum / count with the sign of value
+  int left = kernel->width / 2, right = kernel->width - 1 - left;
+  int top = kernel->height / 2, bottom = kernel->height - 1 - top;
+  for(int j = 0; j < h; j++) {
+    int y1 = j - top < 0 ? 0 : j - top;
+    int y2 = j + bottom >= h ? h : j + bottom + 1;
+    const int64_t* t1 = table + (size_t) (w + 1) * y1;
+    const int64_t* t2 = table + (size_t) (w + 1) * y2;
+    VALUE* dest = &rl_array_value(result, 0, j);
+    for(int i = 0; i < w; i++) {
+      int x1 = i - left < 0 ? 0 : i - left;
+      int x2 = i + right >= w ? w : i + right + 1;
+      int64_t sum = t2[x2] - t2[x1] - t1[x2] + t1[x1];
+      int64_t mean = sum / ((int64_t) (x2 - x1) * (y2 - y1));
+      dest[i] = value > 0 ? mean : -mean;
+    }
+  }
+  free(table);
+}
+
+static int64_t gcd64(int64_t a, int64_t b) {
+  while(b != 0) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// finds integer row and column vectors whose outer product is the kernel
+static int kernel_factor(array_t* kernel, int64_t* row, int64_t* column) {
+  int pivot_i = -1, pivot_j = -1;
+  for(int j = 0; j < kernel->height && pivot_i < 0; j++)
+    for(int i = 0; i < kernel->width && pivot_i < 0; i++)
+      if(rl_array_value(kernel, i, j) != 0) {
+        pivot_i = i;
+        pivot_j = j;
+      }
+  if(pivot_i < 0) return 0;
+  // the row is reduced by its gcd so that the column stays integer
+  int64_t divisor = 0;
+  for(int i = 0; i < kernel->width; i++) divisor = gcd64(divisor, llabs(rl_array_value(kernel, i, pivot_j)));
+  for(int i = 0; i < kernel->width; i++) row[i] = rl_array_value(kernel, i, pivot_j) / divisor;
+  for(int j = 0; j < kernel->height; j++) {
+    int64_t value = rl_array_value(kernel, pivot_i, j);
+    if(value % row[pivot_i] != 0) return 0;
+    column[j] = value / row[pivot_i];
+  }
+  for(int j = 0; j < kernel->height; j++)
+    for(int i = 0; i < kernel->width; i++)
+      if(row[i] * column[j] != rl_array_value(kernel, i, j)) return 0;
+  return 1;
+}
+
+static void apply_kernel_separable(array_t* a, array_t* result, array_t* kernel, const int64_t* row, const int64_t* column) {
+  int w = a->width, h = a->height;
+  int left = kernel->width / 2, top = kernel->height / 2;
+  int64_t* horizontal = malloc(sizeof(int64_t) * w * h);
+  int64_t* sum = malloc(sizeof(int64_t) * w);
+  int64_t* num = malloc(sizeof(int64_t) * w);
+  int64_t* row_num = malloc(sizeof(int64_t) * w);
+  memset(horizontal, 0, sizeof(int64_t) * w * h);
+  memset(row_num, 0, sizeof(int64_t) * w);
+  for(int k = 0; k < kernel->width; k++) {
+    if(row[k] == 0) continue;
+    int start, end;
+    kernel_tap_range(k - left, w, &start, &end);
+    for(int i = start; i < end; i++) row_num[i] += llabs(row[k]);
+    for(int y = 0; y < h; y++)
+      row_multiply_add(horizontal + (size_t) w * y + start, &rl_array_value(a, start + k - left, y), row[k], end - start);
+  }
+  for(int j = 0; j < h; j++) {
+    int64_t column_num = 0;
+    memset(sum, 0, sizeof(int64_t) * w);
+    for(int k = 0; k < kernel->height; k++) {
+      int y = j + k - top;
+      if(column[k] == 0 || y < 0 || y >= h) continue;
+      column_num += llabs(column[k]);
+      row_multiply_add64(sum, horizontal + (size_t) w * y, column[k], w);
     }
-  return b;
+    for(int i = 0; i < w; i++) num[i] = row_num[i] * column_num;
+    kernel_store_row(result, j, sum, num);
+  }
+  free(row_num);
+  free(num);
+  free(sum);
+  free(horizontal);
+}
+
+static void apply_kernel_generic(array_t* a, array_t* result, array_t* kernel) {
+  int w = a->width, h = a->height;
+  int left = kernel->width / 2, top = kernel->height / 2;
+  int64_t* sum = malloc(sizeof(int64_t) * w);
+  int64_t* num = malloc(sizeof(int64_t) * w);
+  for(int j = 0; j < h; j++) {
+    memset(sum, 0, sizeof(int64_t) * w);
+    memset(num, 0, sizeof(int64_t) * w);
+    for(int k_j = 0; k_j < kernel->height; k_j++) {
+      int y = j + k_j - top;
+      if(y < 0 || y >= h) continue;
+      for(int k_i = 0; k_i < kernel->width; k_i++) {
+        VALUE value = rl_array_value(kernel, k_i, k_j);
+        if(value == 0) continue;
+        int start, end;
+        kernel_tap_range(k_i - left, w, &start, &end);
+        for(int i = start; i < end; i++) num[i] += abs(value);
+        row_multiply_add(sum + start, &rl_array_value(a, start + k_i - left, y), value, end - start);
+      }
+    }
+    kernel_store_row(result, j, sum, num);
+  }
+  free(num);
+  free(sum);
+}
+
+void rl_array_apply_kernel_into(array_t* a, array_t* result, array_t* kernel) {
+  if(a->width != result->width || a->height != result->height) rl_error("size mismatch");
+  require_int32(a);
+  require_int32(kernel);
+  require_int32(result);
+  if(arrays_overlap(a, result) || arrays_overlap(kernel, result)) rl_error("result cannot overlap operands");
+  if(a->width == 0 || a->height == 0) return;
+  VALUE value;
+  if(kernel_is_box(kernel, &value)) {
+    apply_kernel_box(a, result, kernel, value);
+    return;
+  }
+  int64_t* row = malloc(sizeof(int64_t) * (kernel->width + kernel->height));
+  int64_t* column = row + kernel->width;
+  if(kernel->width > 1 && kernel->height > 1 && kernel_factor(kernel, row, column)) apply_kernel_separable(a, result, kernel, row, column);
+  else apply_kernel_generic(a, result, kernel);
+  free(row);
 }
 
 array_t* rl_array_apply_kernel(array_t* a, array_t* kernel) {
   array_t* result = rl_array_new(a->width, a->height);
-  for(int j = 0; j < a->height; j++) {
-    for(int i = 0; i < a->width; i++) {
-      int64_t sum = 0;
-      int num = 0;
-      for(int k_j = 0; k_j < kernel->height; k_j++) {
-        for(int k_i = 0; k_i < kernel->width; k_i++) {
-          int x = i + k_i - kernel->width / 2;
-          int y = j + k_j - kernel->height / 2;
-          if(x >= 0 && x < a->width && y >= 0 && y < a->height) {
-            VALUE value = rl_array_value(kernel, k_i, k_j);
-            sum += rl_array_value(a, x, y) * value;
-            num += abs(value);
+  rl_array_apply_kernel_into(a, result, kernel);
+  return result;
+}
+
+// scanline fill: a seed is extended to the whole span of matching cells on its row, then the rows above
+// and below are scanned once along the span, widened by one cell for diagonals, for new seeds
+#define flood_push(px, py) { \
+  if(num_seeds == capacity) { \
+    capacity *= 2; \
+    seeds = realloc(seeds, sizeof(point_t) * capacity); \
+  } \
+  seeds[num_seeds].x = (px); \
+  seeds[num_seeds].y = (py); \
+  num_seeds++; \
+}
+#define flood_is_visited(i, j) ((visited[((size_t) (j) * width + (i)) >> 6] >> (((size_t) (j) * width + (i)) & 63)) & 1)
+#define flood_matches(row, i, j) ((row)[i] == initial && (visited == NULL || !flood_is_visited(i, j)))
+
+int rl_array_flood_fill(array_t* a, int x, int y, double fill_value, int use_diagonals) {
+  if(x < 0 || x >= a->width || y < 0 || y >= a->height) 
+    rl_error("out of bounds");
+  int width = a->width, height = a->height, reach = use_diagonals ? 1 : 0;
+  int size = 0, capacity = 64, num_seeds = 0;
+  point_t* seeds = malloc(sizeof(point_t) * capacity);
+  uint64_t* visited = NULL;
+  rl_dtype_switch(a->dtype, {
+    T initial = *(T*) rl_array_cell(a, x, y);
+    T fill = rl_convert(T, fill_value);
+    // nan never matches, only the starting cell is filled
+    if(initial != initial) {
+      *(T*) rl_array_cell(a, x, y) = fill;
+      size = 1;
+      break;
+    }
+    // when filling does not change cells, the visited ones have to be remembered
+    if(fill == initial) visited = calloc(((size_t) width * height + 63) / 64, sizeof(uint64_t));
+    flood_push(x, y);
+    while(num_seeds > 0) {
+      point_t seed = seeds[--num_seeds];
+      T* row = rl_array_row(a, seed.y);
+      if(!flood_matches(row, seed.x, seed.y)) continue;
+      int left = seed.x, right = seed.x;
+      while(left > 0 && flood_matches(row, left - 1, seed.y)) left--;
+      while(right < width - 1 && flood_matches(row, right + 1, seed.y)) right++;
+      for(int i = left; i <= right; i++) {
+        row[i] = fill;
+        if(visited != NULL) visited[((size_t) seed.y * width + i) >> 6] |= (uint64_t) 1 << (((size_t) seed.y * width + i) & 63);
+      }
+      size += right - left + 1;
+      int start = left - reach < 0 ? 0 : left - reach;
+      int end = right + reach >= width ? width - 1 : right + reach;
+      for(int j = seed.y - 1; j <= seed.y + 1; j += 2) {
+        if(j < 0 || j >= height) continue;
+        T* other = rl_array_row(a, j);
+        int in_span = 0;
+        for(int i = start; i <= end; i++) {
+          int matches = flood_matches(other, i, j);
+          if(matches && !in_span) flood_push(i, j);
+          in_span = matches;
+        }
+      }
+    }
+  });
+  free(visited);
+  free(seeds);
+  return size;
+}
+
+// union-find over provisional labels, the root of a set is its smallest label
+static uint32_t label_find(uint32_t* parent, uint32_t label) {
+  while(parent[label] != label) {
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+  return label;
+}
+
+static uint32_t label_union(uint32_t* parent, uint32_t a, uint32_t b) {
+  a = label_find(parent, a);
+  b = label_find(parent, b);
+  if(a < b) parent[b] = a;
+  else parent[a] = b;
+  return a < b ? a : b;
+}
+
+#define label_merge(label, other) label = (label) == 0 ? (other) : label_union(parent, label, other)
+
+// first pass gives provisional labels to cells from their left and upper neighbors and records which
+// labels touch, second pass replaces them with consecutive ids and measures the components
+components_t* rl_array_label_components(array_t* a, array_t* labels, int use_diagonals, int has_value, double value) {
+  if(a->width != labels->width || a->height != labels->height) rl_error("size mismatch");
+  require_int32(labels);
+  if(arrays_overlap(a, labels)) rl_error("result cannot overlap operands");
+  int width = a->width, height = a->height;
+  uint32_t capacity = 256, num_labels = 0;
+  uint32_t* parent = malloc(sizeof(uint32_t) * capacity);
+  for(int j = 0; j < height; j++) {
+    VALUE* label_row = &rl_array_value(labels, 0, j);
+    VALUE* label_above = j > 0 ? &rl_array_value(labels, 0, j - 1) : NULL;
+    rl_dtype_switch(a->dtype, {
+      const T* row = rl_array_row(a, j);
+      const T* above = j > 0 ? rl_array_row(a, j - 1) : NULL;
+      T target = rl_convert(T, value);
+      // a value which the dtype cannot hold, such as 1.5 for an integer array, matches no cell
+      int is_representable = rl_representable(T, value);
+      for(int i = 0; i < width; i++) {
+        T v = row[i];
+        if(has_value && (!is_representable || v != target)) {
+          label_row[i] = 0;
+          continue;
+        }
+        uint32_t label = 0;
+        if(i > 0 && row[i - 1] == v) label = label_row[i - 1];
+        if(above != NULL) {
+          if(above[i] == v) label_merge(label, label_above[i]);
+          if(use_diagonals && i > 0 && above[i - 1] == v) label_merge(label, label_above[i - 1]);
+          if(use_diagonals && i < width - 1 && above[i + 1] == v) label_merge(label, label_above[i + 1]);
+        }
+        if(label == 0) {
+          if(++num_labels == capacity) {
+            capacity *= 2;
+            parent = realloc(parent, sizeof(uint32_t) * capacity);
           }
+          label = num_labels;
+          parent[label] = label;
         }
+        label_row[i] = label;
       }
-      if(num != 0) rl_array_value(result, i, j) = sum / num;
+    });
+  }
+
+  // parents are always smaller labels, so in increasing order they already hold the id of their component
+  uint32_t num_components = 0;
+  for(uint32_t label = 1; label <= num_labels; label++)
+    parent[label] = parent[label] == label ? ++num_components : parent[parent[label]];
+  components_t* result = malloc(sizeof(components_t) + sizeof(component_t) * (num_components == 0 ? 0 : num_components - 1));
+  result->size = num_components;
+  for(uint32_t k = 0; k < num_components; k++) {
+    component_t* c = &result->components[k];
+    c->size = 0;
+    c->x = width;
+    c->y = height;
+    c->width = 0;
+    c->height = 0;
+  }
+  // the bounding box keeps its right and bottom edges in width and height until the end
+  for(int j = 0; j < height; j++) {
+    VALUE* label_row = &rl_array_value(labels, 0, j);
+    for(int i = 0; i < width; i++) {
+      if(label_row[i] == 0) continue;
+      uint32_t id = parent[label_row[i]];
+      label_row[i] = id;
+      component_t* c = &result->components[id - 1];
+      c->size++;
+      if(i < c->x) c->x = i;
+      if(j < c->y) c->y = j;
+      if(i + 1 > c->width) c->width = i + 1;
+      if(j + 1 > c->height) c->height = j + 1;
     }
   }
+  for(uint32_t k = 0; k < num_components; k++) {
+    result->components[k].width -= result->components[k].x;
+    result->components[k].height -= result->components[k].y;
+  }
+  free(parent);
   return result;
 }
 
-int rl_array_flood_fill(array_t* a, int x, int y, VALUE fill_value, int use_diagonals) {
-  const int offset_x[8] = {0, -1, 1, 0, -1, 1, -1, 1};
-  const int offset_y[8] = {-1, 0, 0, 1, -1, -1, 1, 1};
-  int offset_size = use_diagonals ? 8 : 4;
-  
-  if(x < 0 || x >= a->width || y < 0 || y >= a->height) 
+// distance transforms give the distance from each cell to the nearest feature cell. euclidean distances are
+// exact and computed in linear time with the method of felzenszwalb and huttenlocher: a pass over columns
+// gives the vertical distance to the nearest feature, then each row takes the lower envelope of the
+// parabolas centered on its cells. chebyshev and manhattan distances use a two-pass chamfer.
+#define DISTANCE_INFINITE (INT32_MAX / 4)
+
+// distances are rounded for integer results, and clamped to their largest value
+static void distance_store_row(array_t* result, int j, const double* distances) {
+  rl_dtype_switch(result->dtype, {
+    T* dest = rl_array_row(result, j);
+    int is_float = (T) 0.5 != 0;
+    for(int i = 0; i < result->width; i++) {
+      double d = distances[i];
+      if(!is_float) d = d > dtype_max[result->dtype] ? dtype_max[result->dtype] : floor(d + 0.5);
+      dest[i] = (T) d;
+    }
+  });
+}
+
+// sets distance to 0 on features and to infinity elsewhere, nearest coordinates of features are their own
+static void distance_init_row(array_t* a, int j, double value, int32_t* distance, int32_t* nearest_x, int32_t* nearest_y) {
+  rl_dtype_switch(a->dtype, {
+    const T* row = rl_array_row(a, j);
+    T target = rl_convert(T, value);
+    int is_representable = rl_representable(T, value);
+    for(int i = 0; i < a->width; i++) {
+      int is_feature = is_representable && row[i] == target;
+      distance[i] = is_feature ? 0 : DISTANCE_INFINITE;
+      if(nearest_x != NULL) nearest_x[i] = is_feature ? i : -1;
+      if(nearest_y != NULL) nearest_y[i] = is_feature ? j : -1;
+    }
+  });
+}
+
+static void distance_euclidean(array_t* a, array_t* result, double value, int32_t* nearest_x, int32_t* nearest_y) {
+  int width = a->width, height = a->height;
+  // vertical distance to the nearest feature of the same column, and its row
+  int32_t* column = malloc(sizeof(int32_t) * width * height);
+  int32_t* column_y = nearest_x != NULL ? malloc(sizeof(int32_t) * width * height) : NULL;
+  for(int j = 0; j < height; j++) {
+    int32_t* g = column + (size_t) width * j;
+    int32_t* gy = column_y != NULL ? column_y + (size_t) width * j : NULL;
+    distance_init_row(a, j, value, g, NULL, gy);
+    if(j == 0) continue;
+    const int32_t* above = g - width;
+    for(int i = 0; i < width; i++) {
+      if(above[i] + 1 < g[i]) {
+        g[i] = above[i] + 1;
+        if(gy != NULL) gy[i] = gy[i - width];
+      }
+    }
+  }
+  for(int j = height - 2; j >= 0; j--) {
+    int32_t* g = column + (size_t) width * j;
+    const int32_t* below = g + width;
+    for(int i = 0; i < width; i++) {
+      if(below[i] + 1 < g[i]) {
+        g[i] = below[i] + 1;
+        if(column_y != NULL) column_y[(size_t) width * j + i] = column_y[(size_t) width * (j + 1) + i];
+      }
+    }
+  }
+
+  // lower envelope of the parabolas (x - q)^2 + g(q)^2 of the cells with a finite g
+  int* sites = malloc(sizeof(int) * width);
+  double* bounds = malloc(sizeof(double) * (width + 1));
+  double* distances = malloc(sizeof(double) * width);
+  for(int j = 0; j < height; j++) {
+    const int32_t* g = column + (size_t) width * j;
+    int k = -1;
+    for(int q = 0; q < width; q++) {
+      if(g[q] >= DISTANCE_INFINITE) continue;
+      double fq = (double) g[q] * g[q] + (double) q * q;
+      double s = -INFINITY;
+      while(k >= 0) {
+        int v = sites[k];
+        s = (fq - ((double) g[v] * g[v] + (double) v * v)) / (2.0 * (q - v));
+        if(s > bounds[k]) break;
+        k--;
+      }
+      k++;
+      sites[k] = q;
+      bounds[k] = k == 0 ? -INFINITY : s;
+      bounds[k + 1] = INFINITY;
+    }
+    int32_t* row_x = nearest_x != NULL ? nearest_x + (size_t) width * j : NULL;
+    int32_t* row_y = nearest_y != NULL ? nearest_y + (size_t) width * j : NULL;
+    if(k < 0) {
+      for(int i = 0; i < width; i++) distances[i] = INFINITY;
+      if(row_x != NULL) {
+        for(int i = 0; i < width; i++) row_x[i] = row_y[i] = -1;
+      }
+    } else {
+      int site = 0;
+      for(int i = 0; i < width; i++) {
+        while(bounds[site + 1] < i) site++;
+        int q = sites[site];
+        distances[i] = sqrt((double) (i - q) * (i - q) + (double) g[q] * g[q]);
+        if(row_x != NULL) {
+          row_x[i] = q;
+          row_y[i] = column_y[(size_t) width * j + q];
+        }
+      }
+    }
+    distance_store_row(result, j, distances);
+  }
+  free(distances);
+  free(bounds);
+  free(sites);
+  free(column_y);
+  free(column);
+}
+
+#define chamfer_relax(d, dx, dy, k, other) { \
+  if(d[other] + 1 < d[k]) { \
+    d[k] = d[other] + 1; \
+    if(dx != NULL) { \
+      dx[k] = dx[other]; \
+      dy[k] = dy[other]; \
+    } \
+  } \
+}
+
+// the forward pass looks at neighbors above and to the left, the backward pass at the other ones
+static void distance_chamfer(array_t* a, array_t* result, double value, int use_diagonals, int32_t* nearest_x, int32_t* nearest_y) {
+  int width = a->width, height = a->height;
+  int32_t* d = malloc(sizeof(int32_t) * width * height);
+  for(int j = 0; j < height; j++) {
+    size_t row = (size_t) width * j;
+    distance_init_row(a, j, value, d + row, nearest_x != NULL ? nearest_x + row : NULL, nearest_y != NULL ? nearest_y + row : NULL);
+  }
+  for(int j = 0; j < height; j++) {
+    for(int i = 0; i < width; i++) {
+      size_t k = (size_t) width * j + i;
+      if(i > 0) chamfer_relax(d, nearest_x, nearest_y, k, k - 1);
+      if(j == 0) continue;
+      chamfer_relax(d, nearest_x, nearest_y, k, k - width);
+      if(use_diagonals && i > 0) chamfer_relax(d, nearest_x, nearest_y, k, k - width - 1);
+      if(use_diagonals && i < width - 1) chamfer_relax(d, nearest_x, nearest_y, k, k - width + 1);
+    }
+  }
+  for(int j = height - 1; j >= 0; j--) {
+    for(int i = width - 1; i >= 0; i--) {
+      size_t k = (size_t) width * j + i;
+      if(i < width - 1) chamfer_relax(d, nearest_x, nearest_y, k, k + 1);
+      if(j == height - 1) continue;
+      chamfer_relax(d, nearest_x, nearest_y, k, k + width);
+      if(use_diagonals && i < width - 1) chamfer_relax(d, nearest_x, nearest_y, k, k + width + 1);
+      if(use_diagonals && i > 0) chamfer_relax(d, nearest_x, nearest_y, k, k + width - 1);
+    }
+  }
+  double* distances = malloc(sizeof(double) * width);
+  for(int j = 0; j < height; j++) {
+    const int32_t* row = d + (size_t) width * j;
+    for(int i = 0; i < width; i++) distances[i] = row[i] >= DISTANCE_INFINITE ? INFINITY : row[i];
+    distance_store_row(result, j, distances);
+  }
+  free(distances);
+  free(d);
+}
+
+// cells without any feature get infinity, or the largest value of integer results, and -1 as nearest coordinates
+void rl_array_distance_transform_into(array_t* a, array_t* result, double value, int metric, array_t* nearest_x, array_t* nearest_y) {
+  if(a->width != result->width || a->height != result->height) rl_error("size mismatch");
+  if(metric < DISTANCE_EUCLIDEAN || metric > DISTANCE_MANHATTAN) rl_error("invalid metric %d", metric);
+  if(arrays_overlap(a, result)) rl_error("result cannot overlap operands");
+  if((nearest_x == NULL) != (nearest_y == NULL)) rl_error("both nearest coordinates are needed");
+  if(nearest_x != NULL) {
+    if(nearest_x->width != a->width || nearest_x->height != a->height || nearest_y->width != a->width || nearest_y->height != a->height) rl_error("size mismatch");
+    require_int32(nearest_x);
+    require_int32(nearest_y);
+    if(arrays_overlap(nearest_x, a) || arrays_overlap(nearest_x, result) || arrays_overlap(nearest_y, a) || 
+        arrays_overlap(nearest_y, result) || arrays_overlap(nearest_x, nearest_y))
+      rl_error("result cannot overlap operands");
+  }
+  if(a->width == 0 || a->height == 0) return;
+  // nearest coordinates are computed in contiguous buffers, the arrays may be views
+  int32_t* x = nearest_x != NULL ? malloc(sizeof(int32_t) * a->width * a->height) : NULL;
+  int32_t* y = nearest_y != NULL ? malloc(sizeof(int32_t) * a->width * a->height) : NULL;
+  if(metric == DISTANCE_EUCLIDEAN) distance_euclidean(a, result, value, x, y);
+  else distance_chamfer(a, result, value, metric == DISTANCE_CHEBYSHEV, x, y);
+  if(x != NULL) {
+    for(int j = 0; j < a->height; j++) {
+      memcpy(&rl_array_value(nearest_x, 0, j), x + (size_t) a->width * j, sizeof(int32_t) * a->width);
+      memcpy(&rl_array_value(nearest_y, 0, j), y + (size_t) a->width * j, sizeof(int32_t) * a->width);
+    }
+  }
+  free(y);
+  free(x);
+}
+
+array_t* rl_array_distance_transform(array_t* a, double value, int metric) {
+  array_t* result = rl_array_new_dtype(a->width, a->height, metric == DISTANCE_EUCLIDEAN ? DTYPE_FLOAT32 : DTYPE_INT32);
+  rl_array_distance_transform_into(a, result, value, metric, NULL, NULL);
+  return result;
+}
+
+// bitmasks: rows are processed 64 cells at a time, views start at an arbitrary bit of their first word
+
+static inline uint64_t bits_mask(uint32_t n) {
+  return n >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << n) - 1;
+}
+
+// n bits of a row starting at bit, with n <= 64
+static inline uint64_t bits_load(const uint64_t* row, uint32_t bit, uint32_t n) {
+  uint32_t word = bit >> 6, shift = bit & 63;
+  uint64_t value = row[word] >> shift;
+  if(shift + n > 64) value |= row[word + 1] << (64 - shift);
+  return value & bits_mask(n);
+}
+
+static inline void bits_store(uint64_t* row, uint32_t bit, uint64_t value, uint32_t n) {
+  uint32_t word = bit >> 6, shift = bit & 63;
+  uint64_t mask = bits_mask(n);
+  value &= mask;
+  row[word] = (row[word] & ~(mask << shift)) | (value << shift);
+  if(shift + n > 64) row[word + 1] = (row[word + 1] & ~(mask >> (64 - shift))) | (value >> (64 - shift));
+}
+
+bitmask_t* rl_bitmask_new(uint32_t width, uint32_t height) {
+  bitmask_t* m = rl_malloc(sizeof(bitmask_t));
+  m->width = width;
+  m->height = height;
+  m->offset = 0;
+  m->words_per_row = (width + 63) / 64;
+  m->is_view = 0;
+  m->words = rl_malloc(sizeof(uint64_t) * m->words_per_row * height);
+  memset(m->words, 0, sizeof(uint64_t) * m->words_per_row * height);
+  return m;
+}
+
+bitmask_t* rl_bitmask_view(bitmask_t* b, int x, int y, uint32_t width, uint32_t height) {
+  if(x >= (int) b->width || y >= (int) b->height) rl_error("empty view");
+  // cells left of or above the bitmask are cut, which can leave nothing
+  if(x < 0) { width = width > (uint32_t) -x ? width + x : 0; x = 0; }
+  if(y < 0) { height = height > (uint32_t) -y ? height + y : 0; y = 0; }
+  if(width == 0 || height == 0) rl_error("empty view");
+  if(x + width > b->width) width = b->width - x;
+  if(y + height > b->height) height = b->height - y;
+  bitmask_t* m = rl_malloc(sizeof(bitmask_t));
+  uint32_t bit = b->offset + x;
+  m->words = rl_bitmask_row(b, y) + (bit >> 6);
+  m->offset = bit & 63;
+  m->words_per_row = b->words_per_row;
+  m->is_view = 1;
+  m->width = width;
+  m->height = height;
+  return m;
+}
+
+void rl_bitmask_free(bitmask_t* m) {
+  if(!m->is_view) rl_free(m->words, sizeof(uint64_t) * m->words_per_row * m->height);
+  rl_free(m, sizeof(bitmask_t));
+}
+
+int rl_bitmask_get(bitmask_t* m, int x, int y) {
+  if(x >= 0 && x < m->width && y >= 0 && y < m->height) {
+    return rl_bitmask_value(m, x, y);
+  }
+  fprintf(stderr, "invalid bitmask get at (%d, %d)\n", x, y);
+  return 0;
+}
+
+void rl_bitmask_set(bitmask_t* m, int x, int y, int value) {
+  if(x >= 0 && x < m->width && y >= 0 && y < m->height) {
+    if(value) rl_bitmask_set_value(m, x, y);
+    else rl_bitmask_clear_value(m, x, y);
+  } else {
+    fprintf(stderr, "invalid bitmask set at (%d, %d)\n", x, y);
+  }
+}
+
+void rl_bitmask_fill(bitmask_t* m, int value) {
+  uint64_t bits = value ? ~(uint64_t) 0 : 0;
+  for(int j = 0; j < m->height; j++) {
+    uint64_t* row = rl_bitmask_row(m, j);
+    for(uint32_t i = 0; i < m->width; i += 64) {
+      uint32_t n = m->width - i < 64 ? m->width - i : 64;
+      bits_store(row, m->offset + i, bits, n);
+    }
+  }
+}
+
+static void bitmask_copy_bits(bitmask_t* src, bitmask_t* dest) {
+  for(int j = 0; j < dest->height; j++) {
+    uint64_t* row_dest = rl_bitmask_row(dest, j);
+    const uint64_t* row_src = rl_bitmask_row(src, j);
+    for(uint32_t i = 0; i < dest->width; i += 64) {
+      uint32_t n = dest->width - i < 64 ? dest->width - i : 64;
+      bits_store(row_dest, dest->offset + i, bits_load(row_src, src->offset + i, n), n);
+    }
+  }
+}
+
+// words covered by two bitmasks intersect
+static int bitmasks_overlap(bitmask_t* a, bitmask_t* b) {
+  if(a->width == 0 || a->height == 0 || b->width == 0 || b->height == 0) return 0;
+  const uint64_t* a_end = rl_bitmask_row(a, a->height - 1) + ((a->offset + a->width - 1) >> 6);
+  const uint64_t* b_end = rl_bitmask_row(b, b->height - 1) + ((b->offset + b->width - 1) >> 6);
+  return a->words <= b_end && b->words <= a_end;
+}
+
+// an operand which overlaps dest without being it is read from a copy, so that shifted views such as
+// m[1:, :] |= m[:-1, :] see the cells as they were before the operation
+static bitmask_t* bitmask_snapshot(bitmask_t* a, bitmask_t* dest, bitmask_t* copy) {
+  int is_same = a->words == dest->words && a->offset == dest->offset && a->words_per_row == dest->words_per_row;
+  if(is_same || !bitmasks_overlap(a, dest)) return a;
+  copy->width = a->width;
+  copy->height = a->height;
+  copy->offset = 0;
+  copy->words_per_row = (a->width + 63) / 64;
+  copy->is_view = 0;
+  copy->words = malloc(sizeof(uint64_t) * copy->words_per_row * copy->height);
+  bitmask_copy_bits(a, copy);
+  return copy;
+}
+
+static void bitmask_snapshot_free(bitmask_t* a, bitmask_t* copy) {
+  if(a == copy) free(copy->words);
+}
+
+#define rl_bitmask_binary_op(name, operator) \
+  void rl_bitmask_##name(bitmask_t* dest, bitmask_t* a_in, bitmask_t* b_in) { \
+    if(a_in->width != b_in->width || a_in->height != b_in->height || a_in->width != dest->width || a_in->height != dest->height) \
+      rl_error("size mismatch"); \
+    bitmask_t a_copy, b_copy; \
+    bitmask_t* a = bitmask_snapshot(a_in, dest, &a_copy); \
+    bitmask_t* b = bitmask_snapshot(b_in, dest, &b_copy); \
+    for(int j = 0; j < dest->height; j++) { \
+      uint64_t* row_dest = rl_bitmask_row(dest, j); \
+      const uint64_t* row_a = rl_bitmask_row(a, j); \
+      const uint64_t* row_b = rl_bitmask_row(b, j); \
+      if(dest->offset == 0 && a->offset == 0 && b->offset == 0) { \
+        for(uint32_t k = 0; k < (dest->width + 63) / 64; k++) { \
+          uint32_t n = dest->width - k * 64 < 64 ? dest->width - k * 64 : 64; \
+          uint64_t value = row_a[k] operator row_b[k]; \
+          if(n == 64) row_dest[k] = value; \
+          else bits_store(row_dest, k * 64, value, n); \
+        } \
+      } else { \
+        for(uint32_t i = 0; i < dest->width; i += 64) { \
+          uint32_t n = dest->width - i < 64 ? dest->width - i : 64; \
+          bits_store(row_dest, dest->offset + i, bits_load(row_a, a->offset + i, n) operator bits_load(row_b, b->offset + i, n), n); \
+        } \
+      } \
+    } \
+    bitmask_snapshot_free(b, &b_copy); \
+    bitmask_snapshot_free(a, &a_copy); \
+  }
+
+rl_bitmask_binary_op(and, &)
+rl_bitmask_binary_op(or, |)
+rl_bitmask_binary_op(xor, ^)
+
+void rl_bitmask_not(bitmask_t* dest, bitmask_t* a_in) {
+  if(a_in->width != dest->width || a_in->height != dest->height) rl_error("size mismatch");
+  bitmask_t copy;
+  bitmask_t* a = bitmask_snapshot(a_in, dest, &copy);
+  for(int j = 0; j < dest->height; j++) {
+    uint64_t* row_dest = rl_bitmask_row(dest, j);
+    const uint64_t* row_a = rl_bitmask_row(a, j);
+    for(uint32_t i = 0; i < dest->width; i += 64) {
+      uint32_t n = dest->width - i < 64 ? dest->width - i : 64;
+      bits_store(row_dest, dest->offset + i, ~bits_load(row_a, a->offset + i, n), n);
+    }
+  }
+  bitmask_snapshot_free(a, &copy);
+}
+
+void rl_bitmask_copy_to(bitmask_t* src_in, bitmask_t* dest) {
+  if(src_in->width != dest->width || src_in->height != dest->height) rl_error("size mismatch");
+  bitmask_t copy;
+  bitmask_t* src = bitmask_snapshot(src_in, dest, &copy);
+  bitmask_copy_bits(src, dest);
+  bitmask_snapshot_free(src, &copy);
+}
+
+uint32_t rl_bitmask_count(bitmask_t* m) {
+  uint32_t count = 0;
+  for(int j = 0; j < m->height; j++) {
+    const uint64_t* row = rl_bitmask_row(m, j);
+    for(uint32_t i = 0; i < m->width; i += 64) {
+      uint32_t n = m->width - i < 64 ? m->width - i : 64;
+      count += __builtin_popcountll(bits_load(row, m->offset + i, n));
+    }
+  }
+  return count;
+}
+
+int rl_bitmask_any(bitmask_t* m) {
+  for(int j = 0; j < m->height; j++) {
+    const uint64_t* row = rl_bitmask_row(m, j);
+    for(uint32_t i = 0; i < m->width; i += 64) {
+      uint32_t n = m->width - i < 64 ? m->width - i : 64;
+      if(bits_load(row, m->offset + i, n) != 0) return 1;
+    }
+  }
+  return 0;
+}
+
+int rl_bitmask_all(bitmask_t* m) {
+  for(int j = 0; j < m->height; j++) {
+    const uint64_t* row = rl_bitmask_row(m, j);
+    for(uint32_t i = 0; i < m->width; i += 64) {
+      uint32_t n = m->width - i < 64 ? m->width - i : 64;
+      if(bits_load(row, m->offset + i, n) != bits_mask(n)) return 0;
+    }
+  }
+  return 1;
+}
+
+#define rl_bitmask_from_array_impl(name, test, ...) \
+  void name(bitmask_t* dest, array_t* a, ##__VA_ARGS__) { \
+    if(a->width != dest->width || a->height != dest->height) rl_error("size mismatch"); \
+    for(int j = 0; j < dest->height; j++) { \
+      uint64_t* row = rl_bitmask_row(dest, j); \
+      rl_dtype_switch(a->dtype, { \
+        const T* values = rl_array_row(a, j); \
+        for(uint32_t i = 0; i < dest->width; i += 64) { \
+          uint32_t n = dest->width - i < 64 ? dest->width - i : 64; \
+          uint64_t bits = 0; \
+          for(uint32_t k = 0; k < n; k++) bits |= (uint64_t) (test) << k; \
+          bits_store(row, dest->offset + i, bits, n); \
+        } \
+      }); \
+    } \
+  }
+
+rl_bitmask_from_array_impl(rl_bitmask_from_array, values[i + k] != 0)
+rl_bitmask_from_array_impl(rl_bitmask_from_array_equal, values[i + k] == value, double value)
+
+void rl_bitmask_to_array(bitmask_t* m, array_t* dest) {
+  if(m->width != dest->width || m->height != dest->height) rl_error("size mismatch");
+  for(int j = 0; j < m->height; j++) {
+    const uint64_t* row = rl_bitmask_row(m, j);
+    rl_dtype_switch(dest->dtype, {
+      T* values = rl_array_row(dest, j);
+      for(uint32_t i = 0; i < m->width; i += 64) {
+        uint32_t n = m->width - i < 64 ? m->width - i : 64;
+        uint64_t bits = bits_load(row, m->offset + i, n);
+        for(uint32_t k = 0; k < n; k++) values[i + k] = (bits >> k) & 1;
+      }
+    });
+  }
+}
+
+// same scanline fill as arrays, spans are written a word at a time
+int rl_bitmask_flood_fill(bitmask_t* m, int x, int y, int value, int use_diagonals) {
+  if(x < 0 || x >= m->width || y < 0 || y >= m->height) 
     rl_error("out of bounds");
-  VALUE initial_value = rl_array_value(a, x, y);
-  int size = 0;
-  point_t* stack = malloc(sizeof(point_t) * a->width * a->height);
-  int stack_size = 1;
-  stack[0].x = x;
-  stack[0].y = y;
-  rl_array_value(a, x, y) = fill_value;
-  while(stack_size > 0) {
-    stack_size--;
-    x = stack[stack_size].x;
-    y = stack[stack_size].y;
-    size++;
-    for(int k = 0; k < offset_size; k++) {
-      int i = x + offset_x[k];
-      int j = y + offset_y[k];
-      if(i < 0 || i >= a->width || j < 0 || j >= a->height) continue;
-      VALUE value = rl_array_value(a, i, j);
-      if(value == initial_value) {
-        rl_array_value(a, i, j) = fill_value;
-        stack[stack_size].x = i;
-        stack[stack_size].y = j;
-        stack_size++;
+  int initial = rl_bitmask_value(m, x, y);
+  value = value ? 1 : 0;
+  if(initial == value) return 0;
+  int width = m->width, height = m->height, reach = use_diagonals ? 1 : 0;
+  int size = 0, capacity = 64, num_seeds = 0;
+  point_t* seeds = malloc(sizeof(point_t) * capacity);
+  flood_push(x, y);
+  while(num_seeds > 0) {
+    point_t seed = seeds[--num_seeds];
+    if(rl_bitmask_value(m, seed.x, seed.y) != initial) continue;
+    int left = seed.x, right = seed.x;
+    while(left > 0 && rl_bitmask_value(m, left - 1, seed.y) == initial) left--;
+    while(right < width - 1 && rl_bitmask_value(m, right + 1, seed.y) == initial) right++;
+    for(int i = left; i <= right; i += 64) {
+      uint32_t n = right - i + 1 < 64 ? right - i + 1 : 64;
+      bits_store(rl_bitmask_row(m, seed.y), m->offset + i, value ? ~(uint64_t) 0 : 0, n);
+    }
+    size += right - left + 1;
+    int start = left - reach < 0 ? 0 : left - reach;
+    int end = right + reach >= width ? width - 1 : right + reach;
+    for(int j = seed.y - 1; j <= seed.y + 1; j += 2) {
+      if(j < 0 || j >= height) continue;
+      int in_span = 0;
+      for(int i = start; i <= end; i++) {
+        int matches = rl_bitmask_value(m, i, j) == initial;
+        if(matches && !in_span) flood_push(i, j);
+        in_span = matches;
       }
     }
   }
-  free(stack);
+  free(seeds);
   return size;
 }
@@ -11,16 +11,67 @@
 #define VALUE_MAX INT_MAX
 #define VALUE_FORMAT "%d"
 
+/* largest per-cell movement cost accepted by dijkstra maps */
+#define DIJKSTRA_MAX_COST 65536
+
+/* element types of arrays, int32 unless created with rl_array_new_dtype */
+#define DTYPE_INT32 0
+#define DTYPE_UINT8 1
+#define DTYPE_INT16 2
+#define DTYPE_FLOAT32 3
+#define rl_dtype_size(dtype) ((dtype) == DTYPE_UINT8 ? 1 : (dtype) == DTYPE_INT16 ? 2 : 4)
+
+/* field of view algorithms */
+#define FOV_RAYCAST 0
+#define FOV_SHADOWCAST 1
+
+typedef struct {
+	int x, y, radius;
+} fov_viewer_t;
+
+/* compression of serialized arrays */
+#define ARRAY_COMPRESS_NONE 0
+#define ARRAY_COMPRESS_DEFLATE 1
+
+/* metrics of distance transforms */
+#define DISTANCE_EUCLIDEAN 0
+#define DISTANCE_CHEBYSHEV 1
+#define DISTANCE_MANHATTAN 2
+
 /* array type */
 typedef struct {
   uint32_t width, height;
 	uint32_t stride;
 	int is_view;
-  VALUE* values;
+	int dtype;
+  VALUE* values; /* elements of type dtype, only VALUE for int32 arrays */
 } array_t;
 
+/* direct access, only valid for int32 arrays */
 #define rl_array_value(a, x, y) ((a)->values[((a)->stride + (a)->width) * (y) + (x)])
 
+/* untyped access for all dtypes */
+#define rl_array_row(a, y) ((void*) ((char*) (a)->values + (size_t) rl_dtype_size((a)->dtype) * ((a)->stride + (a)->width) * (y)))
+#define rl_array_cell(a, x, y) ((void*) ((char*) rl_array_row(a, y) + (size_t) rl_dtype_size((a)->dtype) * (x)))
+
+/* reads and writes cells of any dtype as VALUE, floats are truncated */
+#define rl_array_load(a, x, y) ((a)->dtype == DTYPE_INT32 ? rl_array_value(a, x, y) : rl_array_load_typed(a, x, y))
+#define rl_array_store(a, x, y, value) ((a)->dtype == DTYPE_INT32 ? (void) (rl_array_value(a, x, y) = (value)) : rl_array_store_typed(a, x, y, value))
+
+/* bit-packed boolean array, one bit per cell in 64-bit words */
+typedef struct {
+	uint32_t width, height;
+	uint32_t offset; /* bit of the first column in each row, non-zero for views */
+	uint32_t words_per_row;
+	int is_view;
+	uint64_t* words;
+} bitmask_t;
+
+#define rl_bitmask_row(m, y) ((m)->words + (size_t) (m)->words_per_row * (y))
+#define rl_bitmask_value(m, x, y) ((rl_bitmask_row(m, y)[((m)->offset + (x)) >> 6] >> (((m)->offset + (x)) & 63)) & 1)
+#define rl_bitmask_set_value(m, x, y) (rl_bitmask_row(m, y)[((m)->offset + (x)) >> 6] |= (uint64_t) 1 << (((m)->offset + (x)) & 63))
+#define rl_bitmask_clear_value(m, x, y) (rl_bitmask_row(m, y)[((m)->offset + (x)) >> 6] &= ~((uint64_t) 1 << (((m)->offset + (x)) & 63)))
+
 
 typedef struct {
 	int x, y;
@@ -31,17 +82,109 @@ typedef struct {
 	point_t points[1]; /* variable part */
 } path_t;
 
+/* connected components, with their number of cells and bounding box */
+typedef struct {
+	int size;
+	int x, y, width, height;
+} component_t;
+
+typedef struct {
+	int size;
+	component_t components[1]; /* variable part */
+} components_t;
+
+/* distinct values of an array, with their number of cells */
+typedef struct {
+	double value;
+	uint32_t count;
+} value_count_t;
+
+typedef struct {
+	int size;
+	value_count_t values[1]; /* variable part */
+} value_counts_t;
+
+/* reductions along an axis */
+#define REDUCE_SUM 0
+#define REDUCE_MIN 1
+#define REDUCE_MAX 2
+
+#define PATH_NOT_QUEUED UINT32_MAX
+
+/* scratch memory for path finding, reused across queries */
+typedef struct {
+	uint32_t allocated;
+	uint32_t current_generation;
+	uint32_t heap_size;
+	uint32_t* generation; /* cell was touched by current search if equal to current_generation */
+	uint32_t* came_from;
+	VALUE* cost_so_far;
+	VALUE* priority;
+	uint32_t* heap;
+	uint32_t* heap_position;
+} path_finder_t;
+
+/* bucket queue used by dijkstra maps */
+typedef struct {
+	uint32_t num_buckets;
+	uint32_t queued;
+	uint32_t* buckets;
+	uint32_t* next;
+	uint32_t* prev;
+} dial_queue_t;
+
+/* dijkstra map repaired incrementally when goals or walls change */
+typedef struct {
+	array_t* distances; /* goals are 0, walls -1, unreachable cells VALUE_MAX */
+	dial_queue_t queue;
+	uint8_t* invalid;
+	uint32_t* invalid_cells;
+	VALUE* seeds;
+} distance_map_t;
+
+/* fused expressions over arrays, evaluated row by row without temporary arrays */
+enum {
+	EXPR_ARRAY, EXPR_VALUE,
+	// binary operators, in the order of rl_array_op
+	EXPR_EQUAL, EXPR_GREATER_THAN, EXPR_LESS_THAN, EXPR_GREATER_OR_EQUAL_THAN, EXPR_LESS_OR_EQUAL_THAN, EXPR_NOT_EQUAL,
+	EXPR_AND, EXPR_OR, EXPR_XOR, EXPR_LSHIFT, EXPR_RSHIFT, EXPR_ADD, EXPR_SUB, EXPR_MUL, EXPR_DIV, EXPR_MOD,
+	// unary operators
+	EXPR_MINUS, EXPR_NOT, EXPR_INVERT, EXPR_ABS,
+};
+#define EXPR_IS_BINARY(op) ((op) >= EXPR_EQUAL && (op) <= EXPR_MOD)
+#define EXPR_IS_UNARY(op) ((op) >= EXPR_MINUS && (op) <= EXPR_ABS)
+
+typedef struct expr_node {
+	int op;
+	double value;
+	array_t* array;
+	struct expr_node* left;
+	struct expr_node* right;
+} expr_t;
+
 array_t* rl_array_new(uint32_t width, uint32_t height);
-array_t* rl_array_from_string(const char* string);
+array_t* rl_array_new_dtype(uint32_t width, uint32_t height, int dtype);
+array_t* rl_array_from_string(const char* string, int dtype);
 char* rl_array_to_string(array_t* a);
+size_t rl_array_byte_size(array_t* a);
+void rl_array_to_bytes(array_t* a, void* dest);
+void rl_array_from_bytes(array_t* a, const void* src);
+void rl_array_apply_palette(array_t* a, uint32_t* dest, uint32_t dest_stride, const uint32_t* palette, uint32_t palette_size);
+size_t rl_array_serialized_bound(array_t* a, int compression);
+size_t rl_array_serialize(array_t* a, int compression, void* dest);
+array_t* rl_array_deserialize(const void* data, size_t size, size_t* used);
 array_t* rl_array_view(array_t* b, int x, int y, uint32_t width, uint32_t height);
 void rl_array_free(array_t* a);
 uint32_t rl_array_width(array_t* a);
 uint32_t rl_array_height(array_t* a);
 VALUE rl_array_get(array_t* a, int x, int y);
 void rl_array_set(array_t* a, int x, int y, VALUE value);
-void rl_array_fill(array_t *a, VALUE value);
-void rl_array_replace(array_t *a, VALUE value1, VALUE value2);
+double rl_array_get_number(array_t* a, int x, int y);
+void rl_array_set_number(array_t* a, int x, int y, double value);
+VALUE rl_array_load_typed(array_t* a, int x, int y);
+void rl_array_store_typed(array_t* a, int x, int y, VALUE value);
+void rl_array_fill(array_t *a, double value);
+void rl_array_replace(array_t *a, double value1, double value2);
 void rl_array_random_int(array_t *a, int lower, int upper);
 void rl_array_random_2d(array_t *a, int lower, int upper);
 void rl_array_random(array_t *a);
@@ -50,24 +193,43 @@ void rl_array_draw_line(array_t* a, int x1, int y1, int x2, int y2, VALUE value)
 void rl_array_draw_rect(array_t *a, int x, int y, uint32_t width, uint32_t height, VALUE value);
 void rl_array_fill_rect(array_t *a, int x, int y, uint32_t width, uint32_t height, VALUE value);
 int rl_array_can_see(array_t *a, int x1, int y1, int x2, int y2, VALUE blocking);
-array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE blocking, int light_walls);
+array_t* rl_array_field_of_view(array_t* a, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm);
+void rl_array_field_of_view_into(array_t* a, array_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm);
+void rl_array_field_of_view_bitmask(array_t* a, bitmask_t* result, int xc, int yc, int radius, VALUE blocking, int light_walls, int algorithm);
+void rl_array_field_of_view_batch(array_t* a, array_t** results, const fov_viewer_t* viewers, int num_viewers, VALUE blocking, int light_walls, int algorithm);
 path_t* rl_array_shortest_path(array_t* a, int x1, int y1, int x2, int y2, VALUE blocking);
-void rl_array_dijkstra(array_t* a);
-void rl_array_cell_automaton(array_t* a, const char* definition, int wrap);
-VALUE rl_array_min(array_t *a, VALUE blocking);
-VALUE rl_array_max(array_t* a, VALUE blocking);
-point_t rl_array_argmin(array_t* a, VALUE blocking);
-point_t rl_array_argmax(array_t* a, VALUE blocking);
+path_finder_t* rl_path_finder_new();
+void rl_path_finder_free(path_finder_t* finder);
+path_t* rl_path_finder_shortest_path(path_finder_t* finder, array_t* a, int x1, int y1, int x2, int y2, VALUE blocking);
+void rl_array_dijkstra(array_t* a, array_t* cost);
+distance_map_t* rl_distance_map_new(array_t* level, VALUE blocking);
+void rl_distance_map_free(distance_map_t* map);
+void rl_distance_map_add_goal(distance_map_t* map, int x, int y);
+void rl_distance_map_remove_goal(distance_map_t* map, int x, int y);
+void rl_distance_map_set_blocking(distance_map_t* map, int x, int y, int is_blocking);
+void rl_array_cell_automaton(array_t* a, const char* definition, int warp, int iterations);
+double rl_array_min(array_t *a, double blocking, array_t* mask);
+double rl_array_max(array_t* a, double blocking, array_t* mask);
+point_t rl_array_argmin(array_t* a, double blocking, array_t* mask);
+point_t rl_array_argmax(array_t* a, double blocking, array_t* mask);
 int rl_array_find_random(array_t* a, VALUE needle, int tries, int* rx, int* ry);
 array_t* rl_array_copy(array_t* a, array_t* mask);
 void rl_array_copy_to(array_t* src, array_t* dest, array_t* mask);
+array_t* rl_array_copy_bitmask(array_t* a, bitmask_t* mask);
+void rl_array_copy_to_bitmask(array_t* src, array_t* dest, bitmask_t* mask);
+void rl_array_copy_into(array_t* src, array_t* dest, array_t* mask);
+void rl_array_copy_bitmask_into(array_t* src, array_t* dest, bitmask_t* mask);
 
 #define rl_array_op(name) \
-	array_t* rl_array_left_##name##_value(array_t* a, VALUE value); \
+	array_t* rl_array_left_##name##_value(array_t* a, double value); \
 	array_t* rl_array_left_##name##_other(array_t* a, array_t* other); \
-	array_t* rl_array_right_##name##_value(array_t* a, VALUE value); \
+	array_t* rl_array_right_##name##_value(array_t* a, double value); \
 	array_t* rl_array_right_##name##_other(array_t* a, array_t* other); \
-	void rl_array_inplace_##name##_value(array_t* a, VALUE value); \
+	void rl_array_left_##name##_value_into(array_t* a, array_t* result, double value); \
+	void rl_array_left_##name##_other_into(array_t* a, array_t* result, array_t* other); \
+	void rl_array_right_##name##_value_into(array_t* a, array_t* result, double value); \
+	void rl_array_right_##name##_other_into(array_t* a, array_t* result, array_t* other); \
+	void rl_array_inplace_##name##_value(array_t* a, double value); \
 	void rl_array_inplace_##name##_other(array_t* a, array_t* other); 
 
 rl_array_op(equal);
@@ -90,13 +252,51 @@ rl_array_op(mod);
 array_t* rl_array_unary_minus(array_t* a);
 array_t* rl_array_unary_not(array_t* a);
 array_t* rl_array_unary_invert(array_t* a);
-int rl_array_any_equals(array_t* a, VALUE value);
-int rl_array_all_equal(array_t* a, VALUE value);
-int rl_array_count(array_t* a, VALUE value);
-uint64_t rl_array_sum(array_t* a);
+void rl_array_unary_minus_into(array_t* a, array_t* result);
+void rl_array_unary_not_into(array_t* a, array_t* result);
+void rl_array_unary_invert_into(array_t* a, array_t* result);
+int rl_array_any_equals(array_t* a, double value);
+int rl_array_all_equal(array_t* a, double value);
+int rl_array_count(array_t* a, double value, array_t* mask);
+double rl_array_sum(array_t* a, array_t* mask);
+void rl_array_reduce_axis_into(array_t* a, array_t* result, int op, int axis, double blocking, array_t* mask);
+void rl_array_histogram(array_t* a, int bins, uint32_t* counts, array_t* mask);
+value_counts_t* rl_array_unique(array_t* a, array_t* mask);
 array_t* rl_array_abs(array_t* a);
+void rl_array_abs_into(array_t* a, array_t* result);
 array_t* rl_array_matmul(array_t* a, array_t* b);
+void rl_array_matmul_into(array_t* a, array_t* result, array_t* b);
 array_t* rl_array_apply_kernel(array_t* a, array_t* kernel);
-int rl_array_flood_fill(array_t* a, int x, int y, VALUE fill_value, int use_diagonals);
+void rl_array_apply_kernel_into(array_t* a, array_t* result, array_t* kernel);
+int rl_array_flood_fill(array_t* a, int x, int y, double fill_value, int use_diagonals);
+components_t* rl_array_label_components(array_t* a, array_t* labels, int use_diagonals, int has_value, double value);
+array_t* rl_array_distance_transform(array_t* a, double value, int metric);
+void rl_array_distance_transform_into(array_t* a, array_t* result, double value, int metric, array_t* nearest_x, array_t* nearest_y);
+
+expr_t* rl_expr_array(array_t* a);
+expr_t* rl_expr_value(double value);
+expr_t* rl_expr_binary(int op, expr_t* left, expr_t* right);
+expr_t* rl_expr_unary(int op, expr_t* operand);
+array_t* rl_expr_eval(expr_t* e);
+void rl_expr_eval_into(expr_t* e, array_t* dest);
+
+bitmask_t* rl_bitmask_new(uint32_t width, uint32_t height);
+bitmask_t* rl_bitmask_view(bitmask_t* b, int x, int y, uint32_t width, uint32_t height);
+void rl_bitmask_free(bitmask_t* m);
+int rl_bitmask_get(bitmask_t* m, int x, int y);
+void rl_bitmask_set(bitmask_t* m, int x, int y, int value);
+void rl_bitmask_fill(bitmask_t* m, int value);
+void rl_bitmask_copy_to(bitmask_t* src, bitmask_t* dest);
+void rl_bitmask_and(bitmask_t* dest, bitmask_t* a, bitmask_t* b);
+void rl_bitmask_or(bitmask_t* dest, bitmask_t* a, bitmask_t* b);
+void rl_bitmask_xor(bitmask_t* dest, bitmask_t* a, bitmask_t* b);
+void rl_bitmask_not(bitmask_t* dest, bitmask_t* a);
+uint32_t rl_bitmask_count(bitmask_t* m);
+int rl_bitmask_any(bitmask_t* m);
+int rl_bitmask_all(bitmask_t* m);
+void rl_bitmask_from_array(bitmask_t* dest, array_t* a);
+void rl_bitmask_from_array_equal(bitmask_t* dest, array_t* a, double value);
+void rl_bitmask_to_array(bitmask_t* m, array_t* dest);
+int rl_bitmask_flood_fill(bitmask_t* m, int x, int y, int value, int use_diagonals);
 
 #endif
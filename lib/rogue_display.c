@@ -41,8 +41,10 @@ typedef struct {
 	int running, was_init;
   int key;
 	int mouse_x, mouse_y, mouse_button;
+	int headless; // software rendering without window, only available with the SDL renderer
 	SDL_Window* window;
 	SDL_Renderer* renderer;
+	SDL_Surface* framebuffer; // output of the headless renderer
 #ifdef USE_SDLGPU
 	GPU_Target* screen;
 	GPU_Image* screen_image;
@@ -56,19 +58,42 @@ typedef struct {
 	int is_fullscreen, is_maximized, use_integral_scale;
 	int update_filter;
 	void (*update_callback)(int);
+	int target_generation; // incremented when the content of render targets is lost
+	int fps, vsync; // frame rate targeted by td_present, 0 to only wait for vsync or for no limit
+	int fps_changed;
+	uint64_t next_frame, last_present; // performance counter values
+	double frame_time; // seconds between the two last presented frames
+	int dirty; // something was drawn since the last present
+	int mouse_moved; // a motion callback is pending
 } display_t;
 
 static display_t display;
 
+// the display is only created when first needed, programs which never draw do not open a window
+#define require_display() { if(!display.was_init) td_init_display("pyrogue", 320, 240); }
+
 static void __attribute__((constructor)) _td_init() {
 	memset(&display, 0, sizeof(display_t));
-	td_init_display("pyrogue", 320, 240);
+	// frames are paced by vsync alone, a sleep on top of it would drift against the refresh of the screen
+	display.fps = 0;
+	display.vsync = 1;
+}
+
+// whether presenting a frame waits for the refresh of the screen
+static int has_vsync() {
+#ifdef USE_SDLGPU
+	return SDL_GL_GetSwapInterval() != 0;
+#else
+	SDL_RendererInfo info;
+	return SDL_GetRendererInfo(display.renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+#endif
 }
 
 static void __attribute__((destructor)) _td_fini() {
 	if(display.was_init) {
 #ifndef USE_SDLGPU
 		SDL_DestroyTexture(display.screen);
+		if(display.framebuffer != NULL) SDL_FreeSurface(display.framebuffer);
 #endif
 
 #ifdef USE_SDLGPU
@@ -83,11 +108,25 @@ static void (*rander_callback)(void*) = NULL;
 static void* render_callback_data = NULL;
 void td_present();
 
+// longest wait for events when idle, td_run checks whether it should stop in between
+#define IDLE_TIMEOUT 100
+
 static void null_main_loop() {
 }
 
+// headless mode must be chosen before the display is created, it can also be set with the PYROGUE_HEADLESS environment variable
+void td_set_headless(int headless) {
+	if(display.was_init && display.headless != headless) rl_error("headless mode must be set before the display is created");
+#ifdef USE_SDLGPU
+	if(headless) rl_error("headless mode is not available with SDL_gpu");
+#endif
+	display.headless = headless;
+}
+
 int td_init_display(const char* title, int width, int height) {
 	if(!display.was_init) {
+		const char* headless = SDL_getenv("PYROGUE_HEADLESS");
+		if(headless != NULL && headless[0] != '\0' && strcmp(headless, "0") != 0) td_set_headless(1);
 		display.window_width = width;
 		display.window_height = height;
 		display.device_pixel_ratio = 1;
@@ -95,14 +134,24 @@ int td_init_display(const char* title, int width, int height) {
 		//GPU_SetRequiredFeatures(GPU_FEATURE_BASIC_SHADERS);
 		display.actual_screen = GPU_Init(width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL);
 #else
-		if(SDL_Init(SDL_INIT_VIDEO) < 0) rl_error("could not initialize SDL");
-		display.window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL);
-		if(display.window == NULL) rl_error("cannot create window");
-		display.renderer = SDL_CreateRenderer(display.window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | SDL_RENDERER_PRESENTVSYNC);
+		if(display.headless) {
+			// software renderer drawing to a surface, neither video driver nor window are needed
+			if(SDL_Init(SDL_INIT_EVENTS) < 0) rl_error("could not initialize SDL");
+			display.framebuffer = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+			if(display.framebuffer == NULL) rl_error("cannot create framebuffer");
+			display.renderer = SDL_CreateSoftwareRenderer(display.framebuffer);
+		} else {
+			if(SDL_Init(SDL_INIT_VIDEO) < 0) rl_error("could not initialize SDL");
+			display.window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL);
+			if(display.window == NULL) rl_error("cannot create window");
+			display.renderer = SDL_CreateRenderer(display.window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | SDL_RENDERER_PRESENTVSYNC);
+		}
 		if(display.renderer == NULL) rl_error("cannot create renderer");
 		SDL_SetRenderDrawBlendMode(display.renderer, SDL_BLENDMODE_BLEND);
 #endif
-		SDL_StartTextInput();
+		if(!display.headless) SDL_StartTextInput();
+		// without vsync, such as in headless mode, frames are limited in software instead
+		if(!has_vsync()) display.fps = 60;
 	}
 #ifdef __EMSCRIPTEN__
 	// let canvas handle keyboard events instead of window
@@ -128,7 +177,7 @@ int td_init_display(const char* title, int width, int height) {
 	
 	SDL_SetRenderTarget(display.renderer, display.screen);
 #endif
-	SDL_SetWindowTitle(display.window, title);
+	if(display.window != NULL) SDL_SetWindowTitle(display.window, title);
 
 	display.width = width;
 	display.height = height;
@@ -139,6 +188,7 @@ int td_init_display(const char* title, int width, int height) {
 }
 
 font_t* td_load_font(const char* font_path, float font_size) {
+	require_display();
 	uint32_t font_data_size;
 	char* font_data = fs_load_asset(font_path, &font_data_size);
 	if(font_data == NULL) rl_error("[Errno %d] %s: '%s'", errno, strerror(errno), font_path);
@@ -158,6 +208,7 @@ void td_free_font(font_t* font) {
 }
 
 image_t* td_load_image(const char* filename, int tile_width, int tile_height) {
+	require_display();
 	uint32_t image_data_size;
 	char* image_data = fs_load_asset(filename, &image_data_size);
 	if(image_data == NULL) rl_error("cannot load image '%s' from assets", filename);
@@ -186,9 +237,9 @@ image_t* td_load_image(const char* filename, int tile_width, int tile_height) {
 		free(image_data);
 		rl_error("cannot decode image data '%s'", filename);
 	}
-	image->width = surface->w;
-	image->height = surface->h;
-	image->texture = SDL_CreateTextureFromSurface(display.renderer, surface);
+	image->width = image->surface->w;
+	image->height = image->surface->h;
+	image->texture = SDL_CreateTextureFromSurface(display.renderer, image->surface);
 	if(image->texture == NULL) {
 		SDL_FreeSurface(image->surface);
 		rl_free(image, sizeof(image_t));
@@ -211,52 +262,81 @@ void td_free_image(image_t* image) {
 	rl_free(image, sizeof(image_t));
 }
 
+// palette colors are converted into a buffer kept between calls, images updated every frame do not allocate
+static uint32_t* staging_buffer(size_t size) {
+	static uint32_t* buffer = NULL;
+	static size_t allocated = 0;
+	if(size > allocated) {
+		free(buffer);
+		buffer = malloc(sizeof(uint32_t) * size);
+		allocated = size;
+	}
+	return buffer;
+}
+
 image_t* td_array_to_image(array_t* a, int tile_width, int tile_height, int palette_size, uint32_t* palette) {
+	require_display();
+	// checked before creating the texture, as in td_update_image
+	if(palette_size > 0 && palette != NULL) {
+		if(a->dtype == DTYPE_FLOAT32) rl_error("integer array expected");
+	} else if(a->dtype != DTYPE_INT32) rl_error("int32 array expected");
 	image_t* image = rl_malloc(sizeof(image_t));
 	image->tile_width = tile_width;
 	image->tile_height = tile_height;
 	image->width = a->width;
 	image->height = a->height;
 	image->tiles_per_line = image->tile_width != 0 ? image->width / image->tile_width : 1; // prevent divide by zero
-	int row_size = sizeof(uint32_t) * (a->width + a->stride);
 
 #ifdef USE_SDLGPU
 	image->texture = GPU_CreateImage(a->width, a->height, GPU_FORMAT_RGBA);
+	if(image->texture == NULL) {
+		rl_free(image, sizeof(image_t));
+		rl_error("cannot create texture");
+	}
 	GPU_SetImageFilter(image->texture, GPU_FILTER_NEAREST);
 	GPU_SetAnchor(image->texture, 0, 0);
 	GPU_SetBlending(image->texture, 1);
 	GPU_SetBlendMode(image->texture, GPU_BLEND_NORMAL);
 	GPU_SetSnapMode(image->texture, GPU_SNAP_POSITION_AND_DIMENSIONS);
+#else
+	image->texture = SDL_CreateTexture(display.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, a->width, a->height);
 	if(image->texture == NULL) {
 		rl_free(image, sizeof(image_t));
 		rl_error("cannot create texture");
 	}
+	image->surface = SDL_CreateRGBSurfaceWithFormat(0, a->width, a->height, 32, SDL_PIXELFORMAT_RGBA32);
+#endif
+	td_update_image(image, a, 0, 0, palette_size, palette);
+	return image;
+}
+
+// uploads the array to the rectangle of the image at (x, y), reusing its texture
+// pixels are read in place for int32 arrays without palette, including views
+void td_update_image(image_t* image, array_t* a, int x, int y, int palette_size, uint32_t* palette) {
+	if(image->texture == NULL) rl_error("invalid image");
+	if(x < 0 || y < 0 || x + (int) a->width > image->width || y + (int) a->height > image->height) rl_error("array does not fit in image");
+	if(a->width == 0 || a->height == 0) return;
+	const uint32_t* pixels;
+	int pitch;
 	if(palette_size > 0 && palette != NULL) {
-		uint32_t* colors = malloc(sizeof(uint32_t) * a->width * a->height);
-		for(int j = 0; j < a->height; j++) {
-			for(int i = 0; i < a->width; i++) {
-				VALUE value = rl_array_value(a, i, j);
-				if(value >= 0 && value < palette_size) colors[j * a->width + i] = palette[value];
-				else colors[j * a->width + i] = 0;
-			}
-		}
-		GPU_UpdateImageBytes(image->texture, NULL, (const unsigned char*)colors, sizeof(uint32_t) * a->width);
-		free(colors);
+		uint32_t* colors = staging_buffer((size_t) a->width * a->height);
+		rl_array_apply_palette(a, colors, a->width, palette, palette_size);
+		pixels = colors;
+		pitch = sizeof(uint32_t) * a->width;
 	} else {
-		GPU_UpdateImageBytes(image->texture, NULL, (const unsigned char*)a->values, row_size);
+		if(a->dtype != DTYPE_INT32) rl_error("int32 array expected");
+		pixels = (const uint32_t*) a->values;
+		pitch = sizeof(uint32_t) * (a->width + a->stride);
 	}
+#ifdef USE_SDLGPU
+	GPU_Rect rect = {x, y, a->width, a->height};
+	GPU_UpdateImageBytes(image->texture, &rect, (const unsigned char*) pixels, pitch);
 #else
-	image->texture = SDL_CreateTexture(display.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, a->width, a->height);
-	image->surface = SDL_CreateRGBSurfaceWithFormat(0, a->width, a->height, 32, SDL_PIXELFORMAT_RGBA32);
-	}
-	if(image->texture == NULL) {
-		rl_free(image, sizeof(image_t));
-		rl_error("cannot create texture");
-	}
-	SDL_UpdateTexture(image->texture, NULL, a->values, row_size);
-	for(int j = 0; j < a->height; j++) memcpy(((uint32_t*) image->surface->pixels) + j * a->width, ((char*) a->values) + j * row_size, sizeof(uint32_t) * a->width);
+	SDL_Rect rect = {x, y, a->width, a->height};
+	SDL_UpdateTexture(image->texture, &rect, pixels, pitch);
+	// the surface is kept for image_to_array
+	for(int j = 0; j < a->height; j++) memcpy((char*) image->surface->pixels + (y + j) * image->surface->pitch + sizeof(uint32_t) * x, (const char*) pixels + j * pitch, sizeof(uint32_t) * a->width);
 #endif
-	return image;
 }
 
 array_t* td_image_to_array(image_t* image) {
@@ -275,6 +355,7 @@ array_t* td_image_to_array(image_t* image) {
 }
 
 void td_draw_image(image_t* image, int x, int y) {
+	display.dirty = 1;
 	if(image->texture == NULL) rl_error("invalid image");
 #ifdef USE_SDLGPU
 	GPU_Blit(image->texture, NULL, display.screen, x, y);
@@ -285,6 +366,7 @@ void td_draw_image(image_t* image, int x, int y) {
 }
 
 void td_draw_tile(image_t* image, int x, int y, int tile) {
+	display.dirty = 1;
 	if(image->texture == NULL) rl_error("invalid image");
 	int tile_x = (tile % image->tiles_per_line) * image->tile_width;
 	int tile_y = (tile / image->tiles_per_line) * image->tile_height;
@@ -300,6 +382,7 @@ void td_draw_tile(image_t* image, int x, int y, int tile) {
 }
 
 void td_colorize_tile(image_t* image, int x, int y, int tile, uint32_t fg, uint32_t bg) {
+	display.dirty = 1;
 	if(image->texture == NULL) rl_error("invalid image");
 	int tile_x = (tile % image->tiles_per_line) * image->tile_width;
 	int tile_y = (tile / image->tiles_per_line) * image->tile_height;
@@ -339,102 +422,337 @@ static int shift_from_mask(uint32_t number) {
   return i;
 }
 
-void td_draw_array(array_t* a, int x, int y, int x_shift, int y_shift, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask) {
+// quads drawn by td_draw_array are accumulated in buffers kept between calls and submitted with one call per layer
+// indices of SDL_gpu are 16-bit, which limits the number of quads in a batch
+#define BATCH_MAX_QUADS 16383
 
-  int tile_width, tile_height;
-	if(tile_image) {
-    if(tile_image->texture == NULL) rl_error("invalid image");
-    if(x_shift == 0) x_shift = tile_image->tile_width;
-    if(y_shift == 0) y_shift = tile_image->tile_height;
-    tile_width = tile_image->tile_width;
-    tile_height = tile_image->tile_height;
-  } else {
-    if(x_shift == 0) x_shift = 1;
-    if(y_shift == 0) y_shift = 1;
-    tile_width = x_shift;
-    tile_height = y_shift;
-  }
+#if defined(USE_SDLGPU) || SDL_VERSION_ATLEAST(2, 0, 18)
+#define USE_BATCH
+#endif
+
+#ifdef USE_SDLGPU
+typedef unsigned short batch_index_t;
+#else
+typedef int batch_index_t;
+#endif
+
+static struct {
+	image_t* image; // NULL for filled rectangles
+	int size, capacity;
+#ifdef USE_SDLGPU
+	float* vertices; // x, y, s, t, r, g, b, a, the texture coordinates are skipped for filled rectangles
+#elif defined(USE_BATCH)
+	SDL_Vertex* vertices;
+#endif
+	batch_index_t* indices;
+} batch;
+
+#ifdef USE_SDLGPU
+static GPU_Target* render_target = NULL; // set by layers to draw batches to their own target instead of the screen
+#endif
+
+static void batch_flush() {
+	if(batch.size == 0) return;
+#ifdef USE_SDLGPU
+	GPU_TriangleBatch(batch.image ? batch.image->texture : NULL, render_target ? render_target : display.screen, batch.size * 4, batch.vertices, batch.size * 6, batch.indices, batch.image ? GPU_BATCH_XY_ST_RGBA : GPU_BATCH_XY_RGBA);
+#elif defined(USE_BATCH)
+	SDL_RenderGeometry(display.renderer, batch.image ? batch.image->texture : NULL, batch.vertices, batch.size * 4, batch.indices, batch.size * 6);
+#endif
+	batch.size = 0;
+}
+
+static void batch_begin(image_t* image) {
+	batch.image = image;
+	batch.size = 0;
+}
 
-  int tile_shift = shift_from_mask(tile_mask);
-  int fg_shift = shift_from_mask(fg_mask);
-  int bg_shift = shift_from_mask(bg_mask);
+#ifdef USE_BATCH
+// grows the buffers up to BATCH_MAX_QUADS, then flushes full batches
+static void batch_reserve() {
+	if(batch.size < batch.capacity) return;
+	if(batch.capacity == BATCH_MAX_QUADS) {
+		batch_flush();
+		return;
+	}
+	int capacity = batch.capacity == 0 ? 1024 : batch.capacity * 2;
+	if(capacity > BATCH_MAX_QUADS) capacity = BATCH_MAX_QUADS;
+#ifdef USE_SDLGPU
+	float* vertices = realloc(batch.vertices, sizeof(float) * 8 * 4 * capacity);
+#else
+	SDL_Vertex* vertices = realloc(batch.vertices, sizeof(SDL_Vertex) * 4 * capacity);
+#endif
+	if(vertices == NULL) rl_error("out of memory");
+	batch.vertices = vertices;
+	batch_index_t* indices = realloc(batch.indices, sizeof(batch_index_t) * 6 * capacity);
+	if(indices == NULL) rl_error("out of memory");
+	batch.indices = indices;
+	// two triangles per quad, the indices do not depend on the content of the batch
+	for(int i = batch.capacity; i < capacity; i++) {
+		batch_index_t* index = indices + 6 * i;
+		index[0] = 4 * i; index[1] = 4 * i + 1; index[2] = 4 * i + 2;
+		index[3] = 4 * i + 2; index[4] = 4 * i + 1; index[5] = 4 * i + 3;
+	}
+	batch.capacity = capacity;
+}
+#endif
 
-	/* split background and foreground drawing to prevent slow switch of gl primitive type */
-  if(bg_palette != NULL) {
-    for(int j = 0; j < a->height; j++) {
-      for(int i = 0; i < a->width; i++) {
-        int num = rl_array_get(a, i, j);
-        int bg_num = (num & bg_mask) >> bg_shift;
-        if(bg_num >= 0 && bg_num < bg_palette_size) {
-          uint32_t bg = bg_palette[bg_num];
+// adds a quad at (x, y), textured with the tile at (tile_x, tile_y) of the batch image and modulated by color
+static void batch_add(int x, int y, int w, int h, int tile_x, int tile_y, uint32_t color) {
 #ifdef USE_SDLGPU
-          SDL_Color bg_color = {td_color_r(bg), td_color_g(bg), td_color_b(bg), td_color_a(bg)};
-          GPU_Rect dst_rect = {x + x_shift * i, y + y_shift * j, tile_width, tile_height};
-          GPU_RectangleFilled2(display.screen, dst_rect, bg_color);
+	batch_reserve();
+	float r = td_color_r(color) / 255.0f, g = td_color_g(color) / 255.0f, b = td_color_b(color) / 255.0f, a = td_color_a(color) / 255.0f;
+	float s0 = 0, t0 = 0, s1 = 0, t1 = 0;
+	if(batch.image != NULL) {
+		GPU_Image* texture = batch.image->texture;
+		s0 = (float) tile_x / texture->texture_w;
+		t0 = (float) tile_y / texture->texture_h;
+		s1 = (float) (tile_x + w) / texture->texture_w;
+		t1 = (float) (tile_y + h) / texture->texture_h;
+	}
+	int floats = batch.image != NULL ? 8 : 6;
+	float* v = batch.vertices + floats * 4 * batch.size;
+	float corners[4][4] = {{x, y, s0, t0}, {x + w, y, s1, t0}, {x, y + h, s0, t1}, {x + w, y + h, s1, t1}};
+	for(int k = 0; k < 4; k++) {
+		*v++ = corners[k][0];
+		*v++ = corners[k][1];
+		if(batch.image != NULL) {
+			*v++ = corners[k][2];
+			*v++ = corners[k][3];
+		}
+		*v++ = r; *v++ = g; *v++ = b; *v++ = a;
+	}
+	batch.size++;
+#elif defined(USE_BATCH)
+	batch_reserve();
+	SDL_Color c = {td_color_r(color), td_color_g(color), td_color_b(color), td_color_a(color)};
+	float s0 = 0, t0 = 0, s1 = 0, t1 = 0;
+	if(batch.image != NULL) {
+		s0 = (float) tile_x / batch.image->width;
+		t0 = (float) tile_y / batch.image->height;
+		s1 = (float) (tile_x + w) / batch.image->width;
+		t1 = (float) (tile_y + h) / batch.image->height;
+	}
+	SDL_Vertex* v = batch.vertices + 4 * batch.size;
+	v[0] = (SDL_Vertex) {{x, y}, c, {s0, t0}};
+	v[1] = (SDL_Vertex) {{x + w, y}, c, {s1, t0}};
+	v[2] = (SDL_Vertex) {{x, y + h}, c, {s0, t1}};
+	v[3] = (SDL_Vertex) {{x + w, y + h}, c, {s1, t1}};
+	batch.size++;
 #else
-          SDL_Rect dst_rect = {x + x_shift * i, y + y_shift * j, tile_width, tile_height};
-          SDL_SetRenderDrawColor(display.renderer, td_color_r(bg), td_color_g(bg), td_color_b(bg), td_color_a(bg));
-          SDL_RenderFillRect(display.renderer, &dst_rect);
+	// SDL before 2.0.18 has no geometry api, quads are drawn one by one
+	SDL_Rect dst_rect = {x, y, w, h};
+	if(batch.image == NULL) {
+		SDL_SetRenderDrawColor(display.renderer, td_color_r(color), td_color_g(color), td_color_b(color), td_color_a(color));
+		SDL_RenderFillRect(display.renderer, &dst_rect);
+	} else {
+		SDL_Rect src_rect = {tile_x, tile_y, w, h};
+		SDL_SetTextureColorMod(batch.image->texture, td_color_r(color), td_color_g(color), td_color_b(color));
+		SDL_SetTextureAlphaMod(batch.image->texture, td_color_a(color));
+		SDL_RenderCopy(display.renderer, batch.image->texture, &src_rect, &dst_rect);
+		SDL_SetTextureColorMod(batch.image->texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(batch.image->texture, 255);
+	}
 #endif
-        }
-      }
-      printf("\n");
-    }
-  }
+}
+
+static void tile_style_init(tile_style_t* style, int x_shift, int y_shift, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask) {
+	if(tile_image) {
+		if(tile_image->texture == NULL) rl_error("invalid image");
+		if(x_shift == 0) x_shift = tile_image->tile_width;
+		if(y_shift == 0) y_shift = tile_image->tile_height;
+		style->tile_width = tile_image->tile_width;
+		style->tile_height = tile_image->tile_height;
+	} else {
+		if(x_shift == 0) x_shift = 1;
+		if(y_shift == 0) y_shift = 1;
+		style->tile_width = x_shift;
+		style->tile_height = y_shift;
+	}
+	style->x_shift = x_shift;
+	style->y_shift = y_shift;
+	style->tile_image = tile_image;
+	style->tile_map = tile_map;
+	style->tile_map_size = tile_map_size;
+	style->fg_palette = fg_palette;
+	style->fg_palette_size = fg_palette_size;
+	style->bg_palette = bg_palette;
+	style->bg_palette_size = bg_palette_size;
+	style->tile_mask = tile_mask;
+	style->fg_mask = fg_mask;
+	style->bg_mask = bg_mask;
+	style->tile_shift = shift_from_mask(tile_mask);
+	style->fg_shift = shift_from_mask(fg_mask);
+	style->bg_shift = shift_from_mask(bg_mask);
+}
+
+// draws the backgrounds of the listed cells, or of all cells when cells is NULL, as a single batch
+// with clear set, cells without background are drawn transparent
+static void draw_backgrounds(const tile_style_t* style, array_t* a, int x, int y, const int* cells, int num_cells, int clear) {
+	batch_begin(NULL);
+	for(int k = 0; k < num_cells; k++) {
+		int cell = cells != NULL ? cells[k] : k;
+		int i = cell % a->width, j = cell / a->width;
+		uint32_t num = rl_array_load(a, i, j);
+		uint32_t bg_num = (num & style->bg_mask) >> style->bg_shift;
+		uint32_t bg = 0;
+		if(style->bg_palette != NULL && bg_num < (uint32_t) style->bg_palette_size) bg = style->bg_palette[bg_num];
+		else if(!clear) continue;
+		batch_add(x + style->x_shift * i, y + style->y_shift * j, style->tile_width, style->tile_height, 0, 0, bg);
+	}
+	batch_flush();
+}
+
+// draws the tiles of the listed cells, or of all cells when cells is NULL, as a single batch
+static void draw_tiles(const tile_style_t* style, array_t* a, int x, int y, const int* cells, int num_cells) {
+	image_t* tile_image = style->tile_image;
+	batch_begin(tile_image);
+	for(int k = 0; k < num_cells; k++) {
+		int cell = cells != NULL ? cells[k] : k;
+		int i = cell % a->width, j = cell / a->width;
+		uint32_t num = rl_array_load(a, i, j);
+		uint32_t fg_num = (num & style->fg_mask) >> style->fg_shift;
+		uint32_t tile_num = (num & style->tile_mask) >> style->tile_shift;
+
+		uint32_t fg = 0xffffffff; // default to no colormod
+		if(style->fg_palette != NULL && fg_num < (uint32_t) style->fg_palette_size) fg = style->fg_palette[fg_num];
+
+		int tile = tile_num;
+		if(style->tile_map != NULL) {
+			if(tile_num < (uint32_t) style->tile_map_size) tile = style->tile_map[tile_num];
+			else continue;
+		}
+		int tile_x = (tile % tile_image->tiles_per_line) * style->tile_width;
+		int tile_y = (tile / tile_image->tiles_per_line) * style->tile_height;
+		batch_add(x + style->x_shift * i, y + style->y_shift * j, style->tile_width, style->tile_height, tile_x, tile_y, fg);
+	}
+	batch_flush();
+}
 
-  if(tile_image != NULL) {
-    for(int j = 0; j < a->height; j++) {
-      for(int i = 0; i < a->width; i++) {
-        int num = rl_array_get(a, i, j);
-        int fg_num = (num & fg_mask) >> fg_shift;
-        int tile_num = (num & tile_mask) >> tile_shift;
+void td_draw_array(array_t* a, int x, int y, int x_shift, int y_shift, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask) {
+	require_display();
+	display.dirty = 1;
+	tile_style_t style;
+	tile_style_init(&style, x_shift, y_shift, tile_image, tile_map, tile_map_size, tile_mask, fg_palette, fg_palette_size, fg_mask, bg_palette, bg_palette_size, bg_mask);
+
+	/* split background and foreground drawing, each layer is a single batch */
+	if(bg_palette != NULL) draw_backgrounds(&style, a, x, y, NULL, a->width * a->height, 0);
+	if(tile_image != NULL) draw_tiles(&style, a, x, y, NULL, a->width * a->height);
+}
+
+static void* copy_table(const void* table, int size) {
+	if(table == NULL) return NULL;
+	void* copy = malloc(sizeof(uint32_t) * (size == 0 ? 1 : size));
+	memcpy(copy, table, sizeof(uint32_t) * size);
+	return copy;
+}
 
-        if(fg_palette != NULL) {
-          uint32_t fg = 0xffffffff; // default to no colormod
-          if(fg_num >= 0 && fg_num < fg_palette_size) fg = fg_palette[fg_num];
+layer_t* td_layer_new(int width, int height, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask) {
+	require_display();
+	if(width <= 0 || height <= 0) rl_error("invalid layer size");
+	if(tile_image == NULL && bg_palette == NULL) rl_error("layer needs an image or a background palette");
+	layer_t* layer = rl_malloc(sizeof(layer_t));
+	memset(layer, 0, sizeof(layer_t));
+	tile_style_init(&layer->style, 0, 0, tile_image, copy_table(tile_map, tile_map_size), tile_map_size, tile_mask, 
+			copy_table(fg_palette, fg_palette_size), fg_palette_size, fg_mask, copy_table(bg_palette, bg_palette_size), bg_palette_size, bg_mask);
+	layer->width = width;
+	layer->height = height;
+	layer->snapshot = rl_array_new(width, height);
+	layer->dirty = malloc(sizeof(int) * width * height);
+	int target_width = layer->style.x_shift * width, target_height = layer->style.y_shift * height;
 #ifdef USE_SDLGPU
-          SDL_Color fg_color = {td_color_r(fg), td_color_g(fg), td_color_b(fg), td_color_a(fg)};
-          GPU_SetColor(tile_image->texture, fg_color);
+	layer->target = GPU_CreateImage(target_width, target_height, GPU_FORMAT_RGBA);
+	if(layer->target != NULL) {
+		GPU_SetImageFilter(layer->target, GPU_FILTER_NEAREST);
+		GPU_SetAnchor(layer->target, 0, 0);
+		GPU_SetBlending(layer->target, 1);
+		GPU_SetBlendMode(layer->target, GPU_BLEND_NORMAL);
+		GPU_LoadTarget(layer->target);
+	}
 #else
-          SDL_SetTextureColorMod(tile_image->texture, td_color_r(fg), td_color_g(fg), td_color_b(fg));
-          SDL_SetTextureAlphaMod(tile_image->texture, td_color_a(fg));
+	layer->target = SDL_CreateTexture(display.renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, target_width, target_height);
+	if(layer->target != NULL) SDL_SetTextureBlendMode(layer->target, SDL_BLENDMODE_BLEND);
 #endif
-        }
+	if(layer->target == NULL) {
+		td_free_layer(layer);
+		rl_error("cannot create render target");
+	}
+	td_invalidate_layer(layer);
+	return layer;
+}
 
-        int tile = tile_num; 
-        if(tile_map != NULL) {
-          if(tile_num >= 0 && tile_num < tile_map_size) tile = tile_map[tile_num];
-          else continue;
-        }
-        int tile_x = (tile % tile_image->tiles_per_line) * tile_width;
-        int tile_y = (tile / tile_image->tiles_per_line) * tile_height;
+void td_free_layer(layer_t* layer) {
+	if(layer->target != NULL) {
 #ifdef USE_SDLGPU
-        GPU_Rect src_rect = {tile_x, tile_y, tile_width, tile_height};
-        GPU_Rect dst_rect = {x + x_shift * i, y + y_shift * j, tile_width, tile_height};
-        GPU_BlitRect(tile_image->texture, &src_rect, display.screen, &dst_rect);
+		GPU_FreeImage(layer->target);
 #else
-        SDL_Rect src_rect = {tile_x, tile_y, tile_width, tile_height};
-        SDL_Rect dst_rect = {x + x_shift * i, y + y_shift * j, tile_width, tile_height};
-        SDL_RenderCopy(display.renderer, tile_image->texture, &src_rect, &dst_rect);
+		SDL_DestroyTexture(layer->target);
 #endif
-      }
-    }
-  }
+	}
+	rl_array_free(layer->snapshot);
+	free(layer->dirty);
+	free(layer->style.tile_map);
+	free(layer->style.fg_palette);
+	free(layer->style.bg_palette);
+	rl_free(layer, sizeof(layer_t));
+}
+
+// the next draw renders all cells again, for example when the tile image was modified
+void td_invalidate_layer(layer_t* layer) {
+	layer->generation = display.target_generation - 1;
+}
 
-  // restore state
-  if(tile_image) {
+// renders the cells that changed since the previous draw into the target, then draws the target at (x, y)
+void td_draw_layer(layer_t* layer, array_t* a, int x, int y) {
+	display.dirty = 1;
+	if(a->width != layer->width || a->height != layer->height) rl_error("array size does not match layer");
+	if(layer->style.tile_image != NULL && layer->style.tile_image->texture == NULL) rl_error("invalid image");
+	int is_valid = layer->generation == display.target_generation;
+	array_t* snapshot = layer->snapshot;
+	int num_dirty = 0;
+	for(int j = 0; j < a->height; j++) {
+		VALUE* previous = rl_array_row(snapshot, j);
+		// rows of int32 arrays are compared as a whole, most rows do not change between frames
+		if(is_valid && a->dtype == DTYPE_INT32 && memcmp(rl_array_row(a, j), previous, sizeof(VALUE) * a->width) == 0) continue;
+		for(int i = 0; i < a->width; i++) {
+			VALUE num = rl_array_load(a, i, j);
+			if(is_valid && num == previous[i]) continue;
+			previous[i] = num;
+			layer->dirty[num_dirty++] = j * a->width + i;
+		}
+	}
+	layer->generation = display.target_generation;
+
+	if(num_dirty > 0) {
+		// backgrounds replace the previous content of the cells, including alpha
 #ifdef USE_SDLGPU
-    GPU_UnsetColor(tile_image->texture);
+		render_target = layer->target->target;
+		GPU_SetShapeBlendMode(GPU_BLEND_SET);
+		draw_backgrounds(&layer->style, a, 0, 0, layer->dirty, num_dirty, 1);
+		GPU_SetShapeBlendMode(GPU_BLEND_NORMAL);
+		if(layer->style.tile_image != NULL) draw_tiles(&layer->style, a, 0, 0, layer->dirty, num_dirty);
+		render_target = NULL;
 #else
-    SDL_SetTextureColorMod(tile_image->texture, 255, 255, 255);
-    SDL_SetTextureAlphaMod(tile_image->texture, 255);
+		SDL_SetRenderTarget(display.renderer, layer->target);
+		SDL_SetRenderDrawBlendMode(display.renderer, SDL_BLENDMODE_NONE);
+		draw_backgrounds(&layer->style, a, 0, 0, layer->dirty, num_dirty, 1);
+		SDL_SetRenderDrawBlendMode(display.renderer, SDL_BLENDMODE_BLEND);
+		if(layer->style.tile_image != NULL) draw_tiles(&layer->style, a, 0, 0, layer->dirty, num_dirty);
+		SDL_SetRenderTarget(display.renderer, display.screen);
+#endif
+	}
+
+#ifdef USE_SDLGPU
+	GPU_Blit(layer->target, NULL, display.screen, x, y);
+#else
+	SDL_Rect rect = {x, y, layer->style.x_shift * layer->width, layer->style.y_shift * layer->height};
+	SDL_RenderCopy(display.renderer, layer->target, NULL, &rect);
 #endif
-  }
 }
 
 
 // TODO: align is not implemented
 void td_draw_text_from_tiles(image_t* image, int orig_x, int orig_y, const char* text, uint32_t color, int align) {
+	display.dirty = 1;
 	if(image->texture == NULL) rl_error("invalid image");
 	int width = strlen(text) * image->tile_width;
 	int height = image->tile_height;
@@ -480,6 +798,7 @@ void td_draw_text_from_tiles(image_t* image, int orig_x, int orig_y, const char*
 }
 
 void td_draw_text(font_t* font, int orig_x, int orig_y, const char* text, uint32_t color, int align, int line_height) {
+	display.dirty = 1;
 	int width, height;
 	td_size_text(font, text, &width, &height);
 	if(align == 0) align = TD_ALIGN_LEFT | TD_ALIGN_TOP;
@@ -522,6 +841,8 @@ void td_size_text(font_t* font, const char* text, int* width, int* height) {
 };
 
 void td_fill_rect(int x, int y, int w, int h, uint32_t color) {
+	require_display();
+	display.dirty = 1;
 #ifdef USE_SDLGPU
 	SDL_Color fg = {td_color_r(color), td_color_g(color), td_color_b(color), td_color_a(color)};
 	GPU_RectangleFilled(display.screen, x, y, x + w, y + h, fg);
@@ -533,6 +854,8 @@ void td_fill_rect(int x, int y, int w, int h, uint32_t color) {
 }
 
 void td_draw_rect(int x, int y, int w, int h, uint32_t color) {
+	require_display();
+	display.dirty = 1;
 #ifdef USE_SDLGPU
 	SDL_Color fg = {td_color_r(color), td_color_g(color), td_color_b(color), td_color_a(color)};
 	GPU_Rectangle(display.screen, x, y, x + w, y + h, fg);
@@ -544,6 +867,8 @@ void td_draw_rect(int x, int y, int w, int h, uint32_t color) {
 }
 
 void td_draw_line(int x1, int y1, int x2, int y2, uint32_t color) {
+	require_display();
+	display.dirty = 1;
 #ifdef USE_SDLGPU
 	SDL_Color fg = {td_color_r(color), td_color_g(color), td_color_b(color), td_color_a(color)};
 	GPU_Line(display.screen, x1, y1, x2, y2, fg);
@@ -560,7 +885,62 @@ void rl_force_redraw() {
 	SDL_PushEvent(&event);
 }
 
+// sleeps until the next frame is due, so that frames are presented at the target frame rate
+// the wait only covers the remainder of the frame, nothing is waited when rendering took longer
+static void wait_next_frame() {
+#ifdef __EMSCRIPTEN__
+	// the browser paces frames with requestAnimationFrame, blocking would stall its event loop
+	// the timing can only be changed once the main loop is running
+	if(display.fps_changed && emscripten_set_main_loop_timing(EM_TIMING_RAF, display.fps > 0 && display.fps < 60 ? 60 / display.fps : 1) == 0) {
+		display.fps_changed = 0;
+	}
+#else
+	if(display.fps > 0) {
+		uint64_t frequency = SDL_GetPerformanceFrequency();
+		uint64_t now = SDL_GetPerformanceCounter();
+		uint64_t period = frequency / display.fps;
+		if(now < display.next_frame) {
+			uint64_t remaining_ms = (display.next_frame - now) * 1000 / frequency;
+			// SDL_Delay can oversleep by a millisecond, the end of the wait polls the counter
+			if(remaining_ms > 1) SDL_Delay(remaining_ms - 1);
+			while((now = SDL_GetPerformanceCounter()) < display.next_frame);
+			display.next_frame += period;
+		} else {
+			// late frames are not caught up
+			display.next_frame = now + period;
+		}
+	}
+#endif
+}
+
+// fps is the maximum number of frames per second, 0 leaves pacing to vsync or disables it
+void td_set_fps(int fps, int vsync) {
+	require_display();
+	if(fps < 0) rl_error("invalid fps");
+	display.fps = fps;
+	display.vsync = vsync;
+	display.fps_changed = 1;
+	display.next_frame = 0;
+#ifndef __EMSCRIPTEN__
+#ifdef USE_SDLGPU
+	SDL_GL_SetSwapInterval(vsync ? 1 : 0);
+#elif SDL_VERSION_ATLEAST(2, 0, 18)
+	SDL_RenderSetVSync(display.renderer, vsync ? 1 : 0);
+#endif
+#endif
+}
+
+double td_frame_time() {
+	return display.frame_time;
+}
+
 void td_present() {
+	require_display();
+	if(display.headless) {
+		// nothing to show, frames are not paced so that tests run as fast as possible
+		display.dirty = 0;
+		return;
+	}
 #ifndef USE_SDLGPU
 	SDL_SetRenderTarget(display.renderer, NULL);
 	td_clear();
@@ -588,7 +968,15 @@ void td_present() {
 	display.window_height = (int) (display.window_height * display.device_pixel_ratio);
 #endif
 	int width = display.window_width, height = display.window_height, x = 0, y = 0;
-	if(width == 0 || height == 0) return;
+	if(width == 0 || height == 0) {
+		// minimized window, frames are still paced so that continuous redraws do not spin
+		wait_next_frame();
+#ifndef USE_SDLGPU
+		SDL_SetRenderTarget(display.renderer, display.screen);
+#endif
+		display.dirty = 0;
+		return;
+	}
 	if(width * display.height / height < display.width) {
 		int new_height = (int) display.height * width / display.width;
 		y = (height - new_height) / 2;
@@ -610,14 +998,19 @@ void td_present() {
 	SDL_RenderCopy(display.renderer, display.screen, NULL, &display.scaled_rect);
 	SDL_RenderPresent(display.renderer);
 #endif
-	// TODO: wait only the time needed to achieve fps
-	SDL_Delay(1000 / 60);
+	wait_next_frame();
+	uint64_t now = SDL_GetPerformanceCounter();
+	if(display.last_present != 0) display.frame_time = (double) (now - display.last_present) / SDL_GetPerformanceFrequency();
+	display.last_present = now;
 #ifndef USE_SDLGPU
 	SDL_SetRenderTarget(display.renderer, display.screen);
 #endif
+	display.dirty = 0;
 }
 
 void td_clear() {
+	require_display();
+	display.dirty = 1;
 #ifdef USE_SDLGPU
 	GPU_Clear(display.screen);
 #else
@@ -626,6 +1019,22 @@ void td_clear() {
 #endif
 }
 
+// copy of the pixels drawn on the screen since the last clear, as RGBA colors
+array_t* td_screen_to_array() {
+	require_display();
+	array_t* a = rl_array_new(display.width, display.height);
+#ifdef USE_SDLGPU
+	SDL_Surface* surface = GPU_CopySurfaceFromImage(display.screen_image);
+	if(surface == NULL) rl_error("cannot read screen");
+	for(int j = 0; j < display.height; j++) memcpy(rl_array_row(a, j), (char*) surface->pixels + j * surface->pitch, sizeof(uint32_t) * display.width);
+	SDL_FreeSurface(surface);
+#else
+	// the screen texture is the render target between presents
+	SDL_RenderReadPixels(display.renderer, NULL, SDL_PIXELFORMAT_RGBA32, a->values, sizeof(uint32_t) * display.width);
+#endif
+	return a;
+}
+
 void td_quit() {
 #ifdef __EMSCRIPTEN__
 	emscripten_cancel_main_loop();
@@ -634,10 +1043,32 @@ void td_quit() {
 #endif
 }
 
+// motion callbacks are delayed until another callback or the end of the batch of events
+// bursts of mouse motion result in a single callback
+static void flush_mouse_motion() {
+	if(display.mouse_moved) {
+		display.mouse_moved = 0;
+		display.update_callback(TD_MOUSE_MOVED);
+	}
+}
+
+static void dispatch_event(int event) {
+	flush_mouse_motion();
+	display.update_callback(event);
+}
+
 static void process_events() {
   int need_redraw = 0;
 	SDL_Event event;
-	while(SDL_PollEvent(&event) != 0) {
+	int has_event;
+#ifdef __EMSCRIPTEN__
+	has_event = SDL_PollEvent(&event);
+#else
+	// without continuous redraws, sleep until an event arrives instead of polling
+	if(display.update_filter & TD_ON_REDRAW) has_event = SDL_PollEvent(&event);
+	else has_event = SDL_WaitEventTimeout(&event, IDLE_TIMEOUT);
+#endif
+	for(; has_event; has_event = SDL_PollEvent(&event)) {
 		switch(event.type) {
 			case SDL_QUIT:
 				td_quit();
@@ -655,12 +1086,14 @@ static void process_events() {
           need_redraw = 1;
 				}
 				break;
+			case SDL_RENDER_TARGETS_RESET:
+			case SDL_RENDER_DEVICE_RESET:
+				display.target_generation++;
+				need_redraw = 1;
+				break;
 			case SDL_TEXTINPUT:
 				display.key = event.text.text[0];
-        if(display.update_filter & TD_ON_KEY) {
-          display.update_callback(TD_KEY);
-          need_redraw = 1;
-        }
+        if(display.update_filter & TD_ON_KEY) dispatch_event(TD_KEY);
 				break;
 			case SDL_MOUSEMOTION:
 			case SDL_MOUSEBUTTONUP:
@@ -681,11 +1114,10 @@ static void process_events() {
         if(mouse_state & SDL_BUTTON(SDL_BUTTON_RIGHT)) display.mouse_button |= TD_MOUSE_RIGHT;
 
         if(display.update_filter & TD_ON_MOUSE) {
-          if(event.type == SDL_MOUSEBUTTONUP) display.update_callback(TD_MOUSE_UP);
-          else if(event.type == SDL_MOUSEBUTTONDOWN) display.update_callback(TD_MOUSE_DOWN);
+          if(event.type == SDL_MOUSEBUTTONUP) dispatch_event(TD_MOUSE_UP);
+          else if(event.type == SDL_MOUSEBUTTONDOWN) dispatch_event(TD_MOUSE_DOWN);
           else if(display.mouse_x >= 0 && display.mouse_x < display.width && display.mouse_y >= 0 && display.mouse_y < display.height) 
-            display.update_callback(TD_MOUSE_MOVED);
-          need_redraw = 1;
+            display.mouse_moved = 1;
         }
 				break;
       }
@@ -710,24 +1142,22 @@ static void process_events() {
             && key != SDLK_RALT && key != SDLK_RSHIFT && key != SDLK_RCTRL 
             && key != SDLK_LGUI && key != SDLK_RGUI) { 
           display.key = key;
-          if(display.update_filter & TD_ON_KEY) {
-            display.update_callback(TD_KEY);
-            need_redraw = 1;
-          }
+          if(display.update_filter & TD_ON_KEY) dispatch_event(TD_KEY);
         }
         break;
 
       }
 		}
 	}
-  if(display.update_filter & TD_ON_REDRAW) {
-    display.update_callback(TD_REDRAW);
-    need_redraw = 1;
-  }
-  if(need_redraw) td_present();
+  flush_mouse_motion();
+  if(display.update_filter & TD_ON_REDRAW) display.update_callback(TD_REDRAW);
+  // callbacks that did not draw anything do not cause a present
+  if(need_redraw || display.dirty) td_present();
+  else if(display.update_filter & TD_ON_REDRAW) wait_next_frame();
 }
 
 void td_run(void (*update_callback)(int key), int update_filter) {
+	require_display();
   if(INVALID_BITS(update_filter, TD_FILTER_BITS)) rl_error("invalid event filter");
 	display.update_callback = update_callback;
 	display.update_filter = update_filter;
@@ -27,6 +27,35 @@ typedef struct {
 
 typedef STBTTF_Font font_t;
 
+// how cell values are mapped to tiles and colors, see td_draw_array
+typedef struct {
+	image_t* tile_image;
+	int x_shift, y_shift;
+	int tile_width, tile_height;
+	int* tile_map;
+	int tile_map_size;
+	uint32_t* fg_palette;
+	int fg_palette_size;
+	uint32_t* bg_palette;
+	int bg_palette_size;
+	uint32_t tile_mask, fg_mask, bg_mask;
+	int tile_shift, fg_shift, bg_shift;
+} tile_style_t;
+
+// array rendered to a target kept between frames, each draw only renders the cells changed since the previous one
+typedef struct {
+	int width, height;
+	tile_style_t style; // tile map and palettes are copies owned by the layer
+	array_t* snapshot; // values currently rendered in the target
+	int* dirty;
+	int generation; // target content is valid when equal to the display generation
+#ifdef USE_SDLGPU
+	GPU_Image* target;
+#else
+	SDL_Texture* target;
+#endif
+} layer_t;
+
 // constants
 enum {
   // event filter
@@ -70,16 +99,22 @@ enum {
 
 // TODO: set images as render targets
 int td_init_display(const char* title, int width, int height);
+void td_set_headless(int headless);
 font_t* td_load_font(const char* font_path, float font_size);
 void td_free_font(font_t* font);
 image_t* td_load_image(const char* filename, int tile_width, int tile_height);
 void td_free_image(image_t* image);
 image_t* td_array_to_image(array_t* a, int tile_width, int tile_height, int palette_size, uint32_t* palette);
+void td_update_image(image_t* image, array_t* a, int x, int y, int palette_size, uint32_t* palette);
 array_t* td_image_to_array(image_t* image);
 void td_draw_image(image_t* image, int x, int y);
 void td_draw_tile(image_t* image, int x, int y, int tile);
 void td_colorize_tile(image_t* image, int x, int y, int tile, uint32_t fg, uint32_t bg);
 void td_draw_array(array_t* a, int x, int y, int x_shift, int y_shift, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask);
+layer_t* td_layer_new(int width, int height, image_t* tile_image, int* tile_map, int tile_map_size, uint32_t tile_mask, uint32_t* fg_palette, int fg_palette_size, uint32_t fg_mask, uint32_t* bg_palette, int bg_palette_size, uint32_t bg_mask);
+void td_free_layer(layer_t* layer);
+void td_invalidate_layer(layer_t* layer);
+void td_draw_layer(layer_t* layer, array_t* a, int x, int y);
 // TODO: print utf8 characters
 void td_draw_text(font_t* font, int orig_x, int orig_y, const char* text, uint32_t color, int align, int line_height);
 void td_draw_text_from_tiles(image_t* image, int orig_x, int orig_y, const char* text, uint32_t color, int align);
@@ -88,6 +123,9 @@ void td_fill_rect(int x, int y, int w, int h, uint32_t color);
 void td_draw_rect(int x, int y, int w, int h, uint32_t color);
 void td_draw_line(int x1, int y1, int x2, int y2, uint32_t color);
 void td_clear();
+array_t* td_screen_to_array();
+void td_set_fps(int fps, int vsync);
+double td_frame_time();
 void td_quit();
 void td_run(void (*update_callback)(int key), int update_filter);
 uint32_t td_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <SDL.h>
+
+#include "rogue_thread.h"
+
+// fixed pool of workers sharing one job at a time, indices are handed out with an atomic counter
+static struct {
+	int requested; // 0 until configured, then number of threads including the caller
+	int num_workers;
+	SDL_Thread** workers;
+	SDL_mutex* mutex;
+	SDL_cond* work_ready;
+	SDL_cond* work_done;
+	uint32_t generation;
+	int quit;
+	int pending;
+	rl_task_t task;
+	void* data;
+	int count;
+	SDL_atomic_t next;
+	SDL_atomic_t busy;
+} pool;
+
+static void run_tasks() {
+	int index;
+	while((index = SDL_AtomicAdd(&pool.next, 1)) < pool.count) {
+		pool.task(pool.data, index);
+	}
+}
+
+static int worker_main(void* arg) {
+	// jobs started before this worker existed are not waiting for it
+	uint32_t seen = (uint32_t) (uintptr_t) arg;
+	SDL_LockMutex(pool.mutex);
+	while(1) {
+		while(!pool.quit && pool.generation == seen) SDL_CondWait(pool.work_ready, pool.mutex);
+		if(pool.quit) break;
+		seen = pool.generation;
+		SDL_UnlockMutex(pool.mutex);
+		run_tasks();
+		SDL_LockMutex(pool.mutex);
+		if(--pool.pending == 0) SDL_CondSignal(pool.work_done);
+	}
+	SDL_UnlockMutex(pool.mutex);
+	return 0;
+}
+
+static void pool_start() {
+	if(pool.requested == 0) pool.requested = SDL_GetCPUCount();
+	if(pool.requested <= 1 || pool.workers != NULL) return;
+	pool.mutex = SDL_CreateMutex();
+	pool.work_ready = SDL_CreateCond();
+	pool.work_done = SDL_CreateCond();
+	pool.workers = calloc(pool.requested - 1, sizeof(SDL_Thread*));
+	pool.quit = 0;
+	pool.num_workers = 0;
+	for(int i = 0; i < pool.requested - 1; i++) {
+		// threads may be unavailable, for example on emscripten without pthreads
+		SDL_Thread* thread = SDL_CreateThread(worker_main, "rl_worker", (void*) (uintptr_t) pool.generation);
+		if(thread == NULL) break;
+		pool.workers[pool.num_workers++] = thread;
+	}
+}
+
+void rl_thread_pool_shutdown() {
+	if(pool.workers == NULL) return;
+	SDL_LockMutex(pool.mutex);
+	pool.quit = 1;
+	SDL_CondBroadcast(pool.work_ready);
+	SDL_UnlockMutex(pool.mutex);
+	for(int i = 0; i < pool.num_workers; i++) SDL_WaitThread(pool.workers[i], NULL);
+	free(pool.workers);
+	SDL_DestroyCond(pool.work_ready);
+	SDL_DestroyCond(pool.work_done);
+	SDL_DestroyMutex(pool.mutex);
+	pool.workers = NULL;
+	pool.num_workers = 0;
+}
+
+void rl_set_thread_count(int count) {
+	rl_thread_pool_shutdown();
+	pool.requested = count < 0 ? 1 : count;
+}
+
+int rl_get_thread_count() {
+	if(pool.requested == 0) return SDL_GetCPUCount();
+	return pool.requested;
+}
+
+void rl_parallel_for(int count, rl_task_t task, void* data) {
+	if(count <= 0) return;
+	// nested or concurrent calls run serially
+	if(count == 1 || !SDL_AtomicCAS(&pool.busy, 0, 1)) {
+		for(int i = 0; i < count; i++) task(data, i);
+		return;
+	}
+	pool_start();
+	if(pool.num_workers == 0) {
+		for(int i = 0; i < count; i++) task(data, i);
+		SDL_AtomicSet(&pool.busy, 0);
+		return;
+	}
+	SDL_LockMutex(pool.mutex);
+	pool.task = task;
+	pool.data = data;
+	pool.count = count;
+	SDL_AtomicSet(&pool.next, 0);
+	pool.pending = pool.num_workers;
+	pool.generation++;
+	SDL_CondBroadcast(pool.work_ready);
+	SDL_UnlockMutex(pool.mutex);
+
+	run_tasks();
+
+	SDL_LockMutex(pool.mutex);
+	while(pool.pending > 0) SDL_CondWait(pool.work_done, pool.mutex);
+	SDL_UnlockMutex(pool.mutex);
+	SDL_AtomicSet(&pool.busy, 0);
+}
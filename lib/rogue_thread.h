@@ -0,0 +1,18 @@
+#ifndef __ROGUE_THREAD_H__
+#define __ROGUE_THREAD_H__
+
+// task run by the thread pool on each index in [0, count)
+// tasks must not allocate from the GC or raise errors, they run outside of the interpreter
+typedef void (*rl_task_t)(void* data, int index);
+
+// runs task on all indices using the pool, the calling thread takes part in the work
+// falls back to a serial loop when threads are unavailable or when called from a task
+void rl_parallel_for(int count, rl_task_t task, void* data);
+
+// number of threads used by rl_parallel_for, including the calling thread
+// defaults to the number of cores, 1 disables the pool and 0 restores the default
+void rl_set_thread_count(int count);
+int rl_get_thread_count();
+void rl_thread_pool_shutdown();
+
+#endif
@@ -49,57 +49,81 @@ float rl_distance(float x1, float y1, float x2, float y2) {
 }
 
 // line walking based on libtcod/bresenham_c.c 
-typedef struct {
-	int x1, y1, x2, y2;
-	int dx, dy, sx, sy, e;
-} line_t;
-static line_t line;
-
-void rl_walk_line_start(int x1, int y1, int x2, int y2) {
-	line.x1=x1; line.y1=y1;
-	line.x2=x2; line.y2=y2;
-	line.dx=x2 - x1;
-	line.dy=y2 - y1;
-	if ( line.dx > 0 ) {
-		line.sx=1;
-	} else if ( line.dx < 0 ){
-		line.sx=-1;
-	} else line.sx=0;
-	if ( line.dy > 0 ) {
-		line.sy=1;
-	} else if ( line.dy < 0 ){
-		line.sy=-1;
-	} else line.sy = 0;
-	if ( line.sx*line.dx > line.sy*line.dy ) {
-		line.e = line.sx*line.dx;
-		line.dx *= 2;
-		line.dy *= 2;
+void rl_line_start(line_t* line, int x1, int y1, int x2, int y2) {
+	line->x1=x1; line->y1=y1;
+	line->x2=x2; line->y2=y2;
+	line->dx=x2 - x1;
+	line->dy=y2 - y1;
+	if ( line->dx > 0 ) {
+		line->sx=1;
+	} else if ( line->dx < 0 ){
+		line->sx=-1;
+	} else line->sx=0;
+	if ( line->dy > 0 ) {
+		line->sy=1;
+	} else if ( line->dy < 0 ){
+		line->sy=-1;
+	} else line->sy = 0;
+	if ( line->sx*line->dx > line->sy*line->dy ) {
+		line->e = line->sx*line->dx;
+		line->dx *= 2;
+		line->dy *= 2;
 	} else {
-		line.e = line.sy*line.dy;
-		line.dx *= 2;
-		line.dy *= 2;
+		line->e = line->sy*line->dy;
+		line->dx *= 2;
+		line->dy *= 2;
 	}
 }
-int rl_walk_line_next(int *x, int *y) {
-	if ( line.sx*line.dx > line.sy*line.dy ) {
-		if ( line.x1 == line.x2 ) return 0;
-		line.x1+=line.sx;
-		line.e -= line.sy*line.dy;
-		if ( line.e < 0) {
-			line.y1+=line.sy;
-			line.e+=line.sx*line.dx;
+int rl_line_next(line_t* line, int *x, int *y) {
+	if ( line->sx*line->dx > line->sy*line->dy ) {
+		if ( line->x1 == line->x2 ) return 0;
+		line->x1+=line->sx;
+		line->e -= line->sy*line->dy;
+		if ( line->e < 0) {
+			line->y1+=line->sy;
+			line->e+=line->sx*line->dx;
 		}
 	} else {
-		if ( line.y1 == line.y2 ) return 0;
-		line.y1+=line.sy;
-		line.e -= line.sx*line.dx;
-		if ( line.e < 0) {
-			line.x1+=line.sx;
-			line.e+=line.sy*line.dy;
+		if ( line->y1 == line->y2 ) return 0;
+		line->y1+=line->sy;
+		line->e -= line->sx*line->dx;
+		if ( line->e < 0) {
+			line->x1+=line->sx;
+			line->e+=line->sy*line->dy;
 		}
 	}
-	*x=line.x1;
-	*y=line.y1;
+	*x=line->x1;
+	*y=line->y1;
 	return 1;
 }
 
+uint32_t rl_rasterize_lines(const int* segments, uint32_t num_segments, int* points, uint32_t max_points, uint32_t* offsets) {
+	uint32_t num_points = 0;
+	for(uint32_t i = 0; i < num_segments; i++) {
+		const int* segment = segments + 4 * i;
+		int x = segment[0], y = segment[1], has_next = 1;
+		line_t line;
+		if(offsets != NULL) offsets[i] = num_points;
+		for(rl_line_start(&line, segment[0], segment[1], segment[2], segment[3]); has_next; has_next = rl_line_next(&line, &x, &y)) {
+			if(num_points < max_points) {
+				points[2 * num_points] = x;
+				points[2 * num_points + 1] = y;
+			}
+			num_points++;
+		}
+	}
+	if(offsets != NULL) offsets[num_segments] = num_points;
+	return num_points;
+}
+
+// not reentrant, kept for the python api
+static line_t line;
+
+void rl_walk_line_start(int x1, int y1, int x2, int y2) {
+	rl_line_start(&line, x1, y1, x2, y2);
+}
+
+int rl_walk_line_next(int *x, int *y) {
+	return rl_line_next(&line, x, y);
+}
+
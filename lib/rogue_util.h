@@ -2,6 +2,7 @@
 #define __ROGUE_UTIL_H__
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -20,7 +21,19 @@ extern void* (*rl_malloc)(size_t size);
 extern void* (*rl_realloc)(void* mem, size_t old_size, size_t new_size);
 extern void (*rl_free)(void* mem, size_t size);
 
+// line walking state, owned by the caller so that several lines can be walked at once
+typedef struct {
+	int x1, y1, x2, y2;
+	int dx, dy, sx, sy, e;
+} line_t;
+
 float rl_distance(float x1, float y1, float x2, float y2);
+void rl_line_start(line_t* line, int x1, int y1, int x2, int y2);
+int rl_line_next(line_t* line, int *x, int *y);
+// segments are (x1, y1, x2, y2) quadruples, points receive (x, y) pairs including both ends
+// writes at most max_points points, offsets (num_segments + 1 entries, may be NULL) receive the index of the first point of each segment
+// returns the number of points of all segments, which may exceed max_points
+uint32_t rl_rasterize_lines(const int* segments, uint32_t num_segments, int* points, uint32_t max_points, uint32_t* offsets);
 void rl_walk_line_start(int x1, int y1, int x2, int y2);
 int rl_walk_line_next(int *x, int *y);
 
@@ -347,6 +347,26 @@ typedef struct {
 	array_t* array;
 } mp_obj_rl_array_t;
 
+extern const mp_obj_type_t mp_type_rl_bitmask;
+
+typedef struct {
+	mp_obj_base_t base;
+	bitmask_t* bitmask;
+} mp_obj_rl_bitmask_t;
+
+extern const mp_obj_type_t mp_type_rl_expr;
+
+// scalars are read as floats for float32 arrays so that fractions are kept
+STATIC double mod_rl_array_scalar(array_t* a, mp_obj_t value_in) {
+	if(a->dtype == DTYPE_FLOAT32) return mp_obj_get_float(value_in);
+	return mp_obj_get_int(value_in);
+}
+
+STATIC mp_obj_t mod_rl_array_new_scalar(array_t* a, double value) {
+	if(a->dtype == DTYPE_FLOAT32) return mp_obj_new_float(value);
+	return mp_obj_new_int((mp_int_t) value);
+}
+
 STATIC mp_obj_t mod_rl_array_to_string(mp_obj_t self_in) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
@@ -357,17 +377,26 @@ STATIC mp_obj_t mod_rl_array_to_string(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_to_string_obj, mod_rl_array_to_string);
 
-STATIC mp_obj_t mod_rl_array_from_string(mp_obj_t string_in) {
+STATIC mp_obj_t mod_rl_array_from_string(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_text, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_dtype, MP_ARG_INT, {.u_int = DTYPE_INT32} },
+	};
+	struct {
+		mp_arg_val_t text, dtype;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
 	size_t len;
-	const char *string = mp_obj_str_get_data(string_in, &len);
-	array_t* array = rl_array_from_string(string);
+	const char *string = mp_obj_str_get_data(args.text.u_obj, &len);
+	array_t* array = rl_array_from_string(string, args.dtype.u_int);
 	if(array == NULL) return mp_const_none;
 	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
 	output->base.type = &mp_type_rl_array;
 	output->array = array;
 	return MP_OBJ_FROM_PTR(output);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_from_string_obj, mod_rl_array_from_string);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_from_string_obj, 1, mod_rl_array_from_string);
 
 STATIC mp_obj_t mod_rl_array_from_list(mp_obj_t list) {
 	mp_int_t height = mp_obj_get_int(mp_obj_len(list));
@@ -394,6 +423,157 @@ STATIC mp_obj_t mod_rl_array_from_list(mp_obj_t list) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_from_list_obj, mod_rl_array_from_list);
 
+STATIC mp_obj_t mod_rl_array_from_bytes(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_data, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_width, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_height, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_dtype, MP_ARG_INT, {.u_int = DTYPE_INT32} },
+	};
+	struct {
+		mp_arg_val_t data, width, height, dtype;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(args.data.u_obj, &bufinfo, MP_BUFFER_READ);
+	mp_obj_t output_in = mod_rl_array_get_out(mp_const_none, args.width.u_int, args.height.u_int, args.dtype.u_int);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	if(bufinfo.len != rl_array_byte_size(output->array))
+		mp_raise_msg(&mp_type_ValueError, "data size does not match array size");
+	rl_array_from_bytes(output->array, bufinfo.buf);
+	return output_in;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_from_bytes_obj, 3, mod_rl_array_from_bytes);
+
+STATIC mp_obj_t mod_rl_array_to_bytes(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
+	vstr_t vstr;
+	vstr_init_len(&vstr, rl_array_byte_size(self->array));
+	rl_array_to_bytes(self->array, vstr.buf);
+	return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_to_bytes_obj, mod_rl_array_to_bytes);
+
+// concatenates the binary records of a list of arrays
+STATIC void mod_rl_serialize_arrays_into(mp_obj_t arrays_in, int compression, vstr_t* vstr) {
+	size_t count;
+	mp_obj_t* items;
+	mp_obj_get_array(arrays_in, &count, &items);
+	for(size_t i = 0; i < count; i++) {
+		if(!mp_obj_is_type(items[i], &mp_type_rl_array))
+			mp_raise_msg(&mp_type_TypeError, "arrays should be of type array");
+	}
+	vstr_init(vstr, 64);
+	for(size_t i = 0; i < count; i++) {
+		array_t* array = ((mp_obj_rl_array_t*) MP_OBJ_TO_PTR(items[i]))->array;
+		size_t bound = rl_array_serialized_bound(array, compression);
+		char* dest = vstr_add_len(vstr, bound);
+		size_t size = rl_array_serialize(array, compression, dest);
+		vstr_cut_tail_bytes(vstr, bound - size);
+	}
+}
+
+// returns MP_OBJ_NULL when data is not valid
+STATIC mp_obj_t mod_rl_deserialize_arrays_from(const char* data, size_t size) {
+	mp_obj_t list = mp_obj_new_list(0, NULL);
+	while(size > 0) {
+		size_t used;
+		array_t* array = rl_array_deserialize(data, size, &used);
+		if(array == NULL) return MP_OBJ_NULL;
+		mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+		output->base.type = &mp_type_rl_array;
+		output->array = array;
+		mp_obj_list_append(list, MP_OBJ_FROM_PTR(output));
+		data += used;
+		size -= used;
+	}
+	return list;
+}
+
+STATIC mp_obj_t mod_rl_serialize_arrays(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_arrays, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_compress, MP_ARG_BOOL, {.u_bool = true} },
+	};
+	struct {
+		mp_arg_val_t arrays, compress;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	vstr_t vstr;
+	mod_rl_serialize_arrays_into(args.arrays.u_obj, args.compress.u_bool ? ARRAY_COMPRESS_DEFLATE : ARRAY_COMPRESS_NONE, &vstr);
+	return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_serialize_arrays_obj, 1, mod_rl_serialize_arrays);
+
+STATIC mp_obj_t mod_rl_deserialize_arrays(mp_obj_t data_in) {
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(data_in, &bufinfo, MP_BUFFER_READ);
+	mp_obj_t result = mod_rl_deserialize_arrays_from(bufinfo.buf, bufinfo.len);
+	if(result == MP_OBJ_NULL)
+		mp_raise_msg(&mp_type_ValueError, "invalid array data");
+	return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_deserialize_arrays_obj, mod_rl_deserialize_arrays);
+
+STATIC mp_obj_t mod_rl_save_arrays(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_path, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_arrays, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_compress, MP_ARG_BOOL, {.u_bool = true} },
+	};
+	struct {
+		mp_arg_val_t path, arrays, compress;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	size_t path_len;
+	const char *path = mp_obj_str_get_data(args.path.u_obj, &path_len);
+	vstr_t vstr;
+	mod_rl_serialize_arrays_into(args.arrays.u_obj, args.compress.u_bool ? ARRAY_COMPRESS_DEFLATE : ARRAY_COMPRESS_NONE, &vstr);
+	mp_int_t result = fs_save_pref(path, vstr.buf, vstr.len);
+	vstr_clear(&vstr);
+	return mp_obj_new_bool(result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_save_arrays_obj, 2, mod_rl_save_arrays);
+
+STATIC mp_obj_t mod_rl_load_arrays(mp_obj_t path_in) {
+	size_t len;
+	const char *path = mp_obj_str_get_data(path_in, &len);
+	uint32_t size;
+	char* data = fs_load_pref(path, &size);
+	if(data == NULL) return mp_const_none;
+	// allocating the arrays can raise, data is released before propagating
+	mp_obj_t result;
+	nlr_buf_t nlr;
+	if(nlr_push(&nlr) == 0) {
+		result = mod_rl_deserialize_arrays_from(data, size);
+		nlr_pop();
+	} else {
+		free(data);
+		nlr_jump(nlr.ret_val);
+	}
+	free(data);
+	if(result == MP_OBJ_NULL)
+		mp_raise_msg(&mp_type_ValueError, "invalid array data");
+	return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_load_arrays_obj, mod_rl_load_arrays);
+
+// gives direct access to the cells of arrays whose rows are contiguous, views of part of the rows cannot be exposed
+STATIC mp_int_t mod_rl_array_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
+	(void)flags;
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
+	if(self->array->stride != 0 && self->array->height > 1) return 1;
+	static const char typecodes[] = {'i', 'B', 'h', 'f'};
+	bufinfo->buf = self->array->values;
+	bufinfo->len = rl_array_byte_size(self->array);
+	bufinfo->typecode = typecodes[self->array->dtype];
+	return 0;
+}
+
 /*STATIC mp_obj_t mod_rl_array_get(mp_obj_t self_in, mp_obj_t i_in, mp_obj_t j_in) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
@@ -424,33 +604,93 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_set_obj, 4, 4, mod_rl_ar
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_free_obj, mod_rl_array_free);*/
 
-STATIC mp_obj_t mod_rl_array_equals(mp_obj_t self_in, mp_obj_t other_in) {
-	mp_obj_rl_array_t* self = MP_OBJ_TO_PTR(self_in);
-	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
-	output->base.type = &mp_type_rl_array;
-	if(mp_obj_is_type(other_in, &mp_type_rl_array)) {
-		mp_obj_rl_array_t* other = MP_OBJ_TO_PTR(other_in);
-		output->array = rl_array_left_equal_other(self->array, other->array);
-	} else {
-		output->array = rl_array_left_equal_value(self->array, mp_obj_get_int(other_in));
+// returns the array given as out=, or a new array of the given size and dtype when out is None
+STATIC mp_obj_t mod_rl_array_get_out(mp_obj_t out_in, uint32_t width, uint32_t height, int dtype) {
+	if(out_in == mp_const_none) {
+		mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+		output->base.type = &mp_type_rl_array;
+		output->array = rl_array_new_dtype(width, height, dtype);
+		return MP_OBJ_FROM_PTR(output);
 	}
-	return MP_OBJ_FROM_PTR(output);
+	if(!mp_obj_is_type(out_in, &mp_type_rl_array))
+		mp_raise_msg(&mp_type_TypeError, "out should be of type array");
+	return out_in;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_equals_obj, mod_rl_array_equals);
 
-STATIC mp_obj_t mod_rl_array_not_equals(mp_obj_t self_in, mp_obj_t other_in) {
-	mp_obj_rl_array_t* self = MP_OBJ_TO_PTR(self_in);
-	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
-	output->base.type = &mp_type_rl_array;
-	if(mp_obj_is_type(other_in, &mp_type_rl_array)) {
-		mp_obj_rl_array_t* other = MP_OBJ_TO_PTR(other_in);
-		output->array = rl_array_left_not_equal_other(self->array, other->array);
+typedef void (*mod_rl_array_value_into_t)(array_t* a, array_t* result, double value);
+typedef void (*mod_rl_array_other_into_t)(array_t* a, array_t* result, array_t* other);
+
+STATIC const mp_arg_t mod_rl_array_op_allowed_args[] = {
+	{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+	{ MP_QSTR_other, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+	{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+};
+
+STATIC mp_obj_t mod_rl_array_op_method(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args, mod_rl_array_value_into_t value_into, mod_rl_array_other_into_t other_into) {
+	struct {
+		mp_arg_val_t self, other, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(mod_rl_array_op_allowed_args), mod_rl_array_op_allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t* self = MP_OBJ_TO_PTR(args.self.u_obj);
+	mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, self->array->dtype);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	if(mp_obj_is_type(args.other.u_obj, &mp_type_rl_array)) {
+		mp_obj_rl_array_t* other = MP_OBJ_TO_PTR(args.other.u_obj);
+		other_into(self->array, output->array, other->array);
 	} else {
-		output->array = rl_array_left_not_equal_value(self->array, mp_obj_get_int(other_in));
+		value_into(self->array, output->array, mod_rl_array_scalar(self->array, args.other.u_obj));
 	}
-	return MP_OBJ_FROM_PTR(output);
-}
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_not_equals_obj, mod_rl_array_not_equals);
+	return output_in;
+}
+
+// named versions of the binary operators which can write to an existing array
+#define mod_rl_array_op_method_impl(method, name) \
+	STATIC mp_obj_t mod_rl_array_##method(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) { \
+		return mod_rl_array_op_method(n_args, pos_args, kw_args, rl_array_right_##name##_value_into, rl_array_right_##name##_other_into); \
+	} \
+	STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_##method##_obj, 2, mod_rl_array_##method);
+
+mod_rl_array_op_method_impl(equals, equal);
+mod_rl_array_op_method_impl(not_equals, not_equal);
+mod_rl_array_op_method_impl(greater, greater_than);
+mod_rl_array_op_method_impl(less, less_than);
+mod_rl_array_op_method_impl(greater_equal, greater_or_equal_than);
+mod_rl_array_op_method_impl(less_equal, less_or_equal_than);
+mod_rl_array_op_method_impl(bitwise_and, and);
+mod_rl_array_op_method_impl(bitwise_or, or);
+mod_rl_array_op_method_impl(bitwise_xor, xor);
+mod_rl_array_op_method_impl(left_shift, lshift);
+mod_rl_array_op_method_impl(right_shift, rshift);
+mod_rl_array_op_method_impl(add, add);
+mod_rl_array_op_method_impl(subtract, sub);
+mod_rl_array_op_method_impl(multiply, mul);
+mod_rl_array_op_method_impl(divide, div);
+mod_rl_array_op_method_impl(mod, mod);
+
+#define mod_rl_array_unary_method_impl(method, name) \
+	STATIC mp_obj_t mod_rl_array_##method(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) { \
+		static const mp_arg_t allowed_args[] = { \
+			{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} }, \
+			{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} }, \
+		}; \
+		struct { \
+			mp_arg_val_t self, out; \
+		} args; \
+		mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args); \
+		mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array)); \
+		mp_obj_rl_array_t* self = MP_OBJ_TO_PTR(args.self.u_obj); \
+		mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, self->array->dtype); \
+		mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in); \
+		rl_array_##name##_into(self->array, output->array); \
+		return output_in; \
+	} \
+	STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_##method##_obj, 1, mod_rl_array_##method);
+
+mod_rl_array_unary_method_impl(negative, unary_minus);
+mod_rl_array_unary_method_impl(invert, unary_invert);
+mod_rl_array_unary_method_impl(absolute, abs);
 
 STATIC void mod_rl_array_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_t kind) {
 	mp_obj_rl_array_t *o = MP_OBJ_TO_PTR(o_in);
@@ -461,8 +701,12 @@ STATIC void mod_rl_array_print(const mp_print_t *print, mp_obj_t o_in, mp_print_
 		mp_print_str(print, "[");
 		for(int i = 0; i < width; i++) {
 			if(i > 0) mp_print_str(print, ", ");
-			mp_int_t value = rl_array_get(o->array, i, j);
-			mp_printf(print, "%d", value);
+			if(o->array->dtype == DTYPE_FLOAT32) {
+				mp_printf(print, "%g", rl_array_get_number(o->array, i, j));
+			} else {
+				mp_int_t value = rl_array_get(o->array, i, j);
+				mp_printf(print, "%d", value);
+			}
 		}
 		if(j < height - 1) mp_print_str(print, "], ");
 		else mp_print_str(print, "]");
@@ -512,8 +756,8 @@ STATIC mp_obj_t mod_rl_array_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_
 					rl_array_copy_to(other->array, view, NULL);
 					rl_array_free(view);
 				} else {
-					mp_int_t value = mp_obj_get_int(value_in);
-					rl_array_fill(self->array, value);
+					rl_array_fill(view, mod_rl_array_scalar(self->array, value_in));
+					rl_array_free(view);
 				}
 				return mp_const_none;
 			}
@@ -524,11 +768,9 @@ STATIC mp_obj_t mod_rl_array_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_
 			if(i < 0) i += self->array->width;
 			if(j < 0) j += self->array->height;
 			if(value_in == MP_OBJ_SENTINEL) { // get
-				mp_int_t result = rl_array_get(self->array, i, j);
-				return mp_obj_new_int(result);
+				return mod_rl_array_new_scalar(self->array, rl_array_get_number(self->array, i, j));
 			} else { // set
-				mp_int_t value = mp_obj_get_int(value_in);
-				rl_array_set(self->array, i, j, value);
+				rl_array_set_number(self->array, i, j, mod_rl_array_scalar(self->array, value_in));
 				return mp_const_none;
 			}
 		}
@@ -554,11 +796,17 @@ STATIC mp_obj_t mod_rl_array_height(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_height_obj, mod_rl_array_height);
 
+STATIC mp_obj_t mod_rl_array_dtype(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(self->array->dtype);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_dtype_obj, mod_rl_array_dtype);
+
 STATIC mp_obj_t mod_rl_array_fill(mp_obj_t self_in, mp_obj_t value_in) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_int_t value = mp_obj_get_int(value_in);
-	rl_array_fill(self->array, value);
+	rl_array_fill(self->array, mod_rl_array_scalar(self->array, value_in));
 	return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_fill_obj, mod_rl_array_fill);
@@ -566,8 +814,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_fill_obj, mod_rl_array_fill);
 STATIC mp_obj_t mod_rl_array_replace(mp_obj_t self_in, mp_obj_t value_in, mp_obj_t replacement_in) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_int_t value = mp_obj_get_int(value_in);
-	mp_int_t replacement = mp_obj_get_int(replacement_in);
+	double value = mod_rl_array_scalar(self->array, value_in);
+	double replacement = mod_rl_array_scalar(self->array, replacement_in);
 	rl_array_replace(self->array, value, replacement);
 	return mp_const_none;
 }
@@ -671,30 +919,122 @@ STATIC mp_obj_t mod_rl_array_can_see(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_can_see_obj, 5, 6, mod_rl_array_can_see);
 
-STATIC mp_obj_t mod_rl_array_field_of_view(size_t n_args, const mp_obj_t *args) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_int_t xc = mp_obj_get_int(args[1]);
-	mp_int_t yc = mp_obj_get_int(args[2]);
-	mp_int_t radius = mp_obj_get_int(args[3]);
-	mp_int_t blocking = 1;
-	if(n_args > 4) blocking = mp_obj_get_int(args[4]);
-	mp_int_t light_walls = 0;
-	if(n_args > 5) light_walls = mp_obj_get_int(args[5]);
+STATIC mp_obj_t mod_rl_array_field_of_view(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_x, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_y, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_radius, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_blocking, MP_ARG_INT, {.u_int = 1} },
+		{ MP_QSTR_light_walls, MP_ARG_BOOL, {.u_bool = false} },
+		{ MP_QSTR_algorithm, MP_ARG_INT, {.u_int = FOV_SHADOWCAST} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, x, y, radius, blocking, light_walls, algorithm, out;
+	} args;
+
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(args.algorithm.u_int != FOV_RAYCAST && args.algorithm.u_int != FOV_SHADOWCAST)
+		mp_raise_msg(&mp_type_ValueError, "unknown field of view algorithm");
+
+	if(mp_obj_is_type(args.out.u_obj, &mp_type_rl_bitmask)) {
+		mp_obj_rl_bitmask_t *out = MP_OBJ_TO_PTR(args.out.u_obj);
+		rl_array_field_of_view_bitmask(self->array, out->bitmask, args.x.u_int, args.y.u_int, args.radius.u_int, args.blocking.u_int, args.light_walls.u_bool, args.algorithm.u_int);
+		return args.out.u_obj;
+	} else if(args.out.u_obj != mp_const_none) {
+		if(!mp_obj_is_type(args.out.u_obj, &mp_type_rl_array)) 
+			mp_raise_msg(&mp_type_TypeError, "out should be of type array or bitmask");
+		mp_obj_rl_array_t *out = MP_OBJ_TO_PTR(args.out.u_obj);
+		rl_array_field_of_view_into(self->array, out->array, args.x.u_int, args.y.u_int, args.radius.u_int, args.blocking.u_int, args.light_walls.u_bool, args.algorithm.u_int);
+		return args.out.u_obj;
+	}
+
 	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
 	output->base.type = &mp_type_rl_array;
-	output->array = rl_array_field_of_view(self->array, xc, yc, radius, blocking, light_walls);
+	output->array = rl_array_field_of_view(self->array, args.x.u_int, args.y.u_int, args.radius.u_int, args.blocking.u_int, args.light_walls.u_bool, args.algorithm.u_int);
 	return MP_OBJ_FROM_PTR(output);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_field_of_view_obj, 4, 6, mod_rl_array_field_of_view);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_field_of_view_obj, 4, mod_rl_array_field_of_view);
 
-STATIC mp_obj_t mod_rl_array_dijkstra(mp_obj_t self_in) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	rl_array_dijkstra(self->array);
+STATIC mp_obj_t mod_rl_array_field_of_view_batch(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_viewers, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_blocking, MP_ARG_INT, {.u_int = 1} },
+		{ MP_QSTR_light_walls, MP_ARG_BOOL, {.u_bool = false} },
+		{ MP_QSTR_algorithm, MP_ARG_INT, {.u_int = FOV_SHADOWCAST} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, viewers, blocking, light_walls, algorithm, out;
+	} args;
+
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(args.algorithm.u_int != FOV_RAYCAST && args.algorithm.u_int != FOV_SHADOWCAST)
+		mp_raise_msg(&mp_type_ValueError, "unknown field of view algorithm");
+
+	size_t num_viewers;
+	mp_obj_t *viewer_items;
+	mp_obj_get_array(args.viewers.u_obj, &num_viewers, &viewer_items);
+	mp_obj_t *out_items = NULL;
+	if(args.out.u_obj != mp_const_none) {
+		size_t num_out;
+		mp_obj_get_array(args.out.u_obj, &num_out, &out_items);
+		if(num_out != num_viewers) mp_raise_msg(&mp_type_IndexError, "out should have one array per viewer");
+	}
+
+	mp_obj_t result = mp_obj_new_list(num_viewers, NULL);
+	mp_obj_t *result_items;
+	mp_obj_get_array(result, &num_viewers, &result_items);
+	fov_viewer_t* viewers = m_new(fov_viewer_t, num_viewers);
+	array_t** results = m_new(array_t*, num_viewers);
+	for(size_t i = 0; i < num_viewers; i++) {
+		mp_obj_t *viewer;
+		mp_obj_get_array_fixed_n(viewer_items[i], 3, &viewer);
+		viewers[i].x = mp_obj_get_int(viewer[0]);
+		viewers[i].y = mp_obj_get_int(viewer[1]);
+		viewers[i].radius = mp_obj_get_int(viewer[2]);
+		if(out_items != NULL) {
+			if(!mp_obj_is_type(out_items[i], &mp_type_rl_array)) 
+				mp_raise_msg(&mp_type_TypeError, "out should contain arrays");
+			result_items[i] = out_items[i];
+			results[i] = ((mp_obj_rl_array_t*) MP_OBJ_TO_PTR(out_items[i]))->array;
+		} else {
+			mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+			output->base.type = &mp_type_rl_array;
+			output->array = rl_array_new(self->array->width, self->array->height);
+			result_items[i] = MP_OBJ_FROM_PTR(output);
+			results[i] = output->array;
+		}
+	}
+	rl_array_field_of_view_batch(self->array, results, viewers, num_viewers, args.blocking.u_int, args.light_walls.u_bool, args.algorithm.u_int);
+	m_del(fov_viewer_t, viewers, num_viewers);
+	m_del(array_t*, results, num_viewers);
+	return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_field_of_view_batch_obj, 2, mod_rl_array_field_of_view_batch);
+
+STATIC mp_obj_t mod_rl_array_dijkstra(size_t n_args, const mp_obj_t *args) {
+	mp_check_self(mp_obj_is_type(args[0], &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
+	array_t* cost = NULL;
+	if(n_args > 1 && args[1] != mp_const_none) {
+		if(!mp_obj_is_type(args[1], &mp_type_rl_array)) 
+			mp_raise_msg(&mp_type_TypeError, "cost should be of type array");
+		mp_obj_rl_array_t* obj_cost = MP_OBJ_TO_PTR(args[1]);
+		cost = obj_cost->array;
+	}
+	rl_array_dijkstra(self->array, cost);
 	return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_dijkstra_obj, mod_rl_array_dijkstra);
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_dijkstra_obj, 1, 2, mod_rl_array_dijkstra);
 
 STATIC mp_obj_t mod_rl_array_shortest_path(size_t n_args, const mp_obj_t *args) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
@@ -705,7 +1045,10 @@ STATIC mp_obj_t mod_rl_array_shortest_path(size_t n_args, const mp_obj_t *args)
 	mp_int_t y2 = mp_obj_get_int(args[4]);
 	mp_int_t blocking = 1;
 	if(n_args > 5) blocking = mp_obj_get_int(args[5]);
-	path_t* path = rl_array_shortest_path(self->array, x1, y1, x2, y2, blocking);
+	// scratch memory is kept between calls to avoid reallocating it for every query
+	static path_finder_t* path_finder = NULL;
+	if(path_finder == NULL) path_finder = rl_path_finder_new();
+	path_t* path = rl_path_finder_shortest_path(path_finder, self->array, x1, y1, x2, y2, blocking);
 	if(path == NULL) {
 		mp_obj_tuple_t *tuple = MP_OBJ_TO_PTR(mp_obj_new_tuple(0, NULL));
 		return tuple;
@@ -723,51 +1066,100 @@ STATIC mp_obj_t mod_rl_array_shortest_path(size_t n_args, const mp_obj_t *args)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_shortest_path_obj, 5, 6, mod_rl_array_shortest_path);
 
-STATIC mp_obj_t mod_rl_array_min(size_t n_args, const mp_obj_t *args) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_int_t blocking = VALUE_MAX;
-	if(n_args > 1) blocking = mp_obj_get_int(args[1]);
-	mp_int_t result = rl_array_min(self->array, blocking);
-	return mp_obj_new_int(result);
+// mask of reductions, cells of self are included where the mask is non-zero
+STATIC array_t* mod_rl_array_get_mask(mp_obj_t mask_in) {
+	if(mask_in == mp_const_none) return NULL;
+	if(!mp_obj_is_type(mask_in, &mp_type_rl_array))
+		mp_raise_msg(&mp_type_TypeError, "mask should be of type array");
+	return ((mp_obj_rl_array_t*) MP_OBJ_TO_PTR(mask_in))->array;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_min_obj, 1, 2, mod_rl_array_min);
 
-STATIC mp_obj_t mod_rl_array_max(size_t n_args, const mp_obj_t *args) {
+// reduces the whole array to a scalar, or each row (axis=0) or column (axis=1) into an array
+STATIC mp_obj_t mod_rl_array_reduce(int op, mp_obj_t self_in, mp_obj_t blocking_in, mp_obj_t axis_in, mp_obj_t mask_in, mp_obj_t out_in) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_int_t blocking = VALUE_MAX;
-	if(n_args > 1) blocking = mp_obj_get_int(args[1]);
-	mp_int_t result = rl_array_max(self->array, blocking);
-	return mp_obj_new_int(result);
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
+	double blocking = VALUE_MAX;
+	if(blocking_in != mp_const_none) blocking = mod_rl_array_scalar(self->array, blocking_in);
+	array_t* mask = mod_rl_array_get_mask(mask_in);
+	if(axis_in == mp_const_none) {
+		double result = op == REDUCE_SUM ? rl_array_sum(self->array, mask)
+			: op == REDUCE_MIN ? rl_array_min(self->array, blocking, mask)
+			: rl_array_max(self->array, blocking, mask);
+		return mod_rl_array_new_scalar(self->array, result);
+	}
+	mp_int_t axis = mp_obj_get_int(axis_in);
+	if(axis != 0 && axis != 1)
+		mp_raise_msg(&mp_type_ValueError, "axis should be 0 or 1");
+	int dtype = self->array->dtype;
+	if(op == REDUCE_SUM && dtype != DTYPE_FLOAT32) dtype = DTYPE_INT32;
+	mp_obj_t output_in = mod_rl_array_get_out(out_in, axis == 0 ? 1 : self->array->width, axis == 0 ? self->array->height : 1, dtype);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	rl_array_reduce_axis_into(self->array, output->array, op, axis, blocking, mask);
+	return output_in;
+}
+
+STATIC mp_obj_t mod_rl_array_min(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_blocking, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_axis, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, blocking, axis, mask, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+	return mod_rl_array_reduce(REDUCE_MIN, args.self.u_obj, args.blocking.u_obj, args.axis.u_obj, args.mask.u_obj, args.out.u_obj);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_max_obj, 1, 2, mod_rl_array_max);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_min_obj, 1, mod_rl_array_min);
 
-STATIC mp_obj_t mod_rl_array_argmin(size_t n_args, const mp_obj_t *args) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_int_t blocking = VALUE_MAX;
-	if(n_args > 1) blocking = mp_obj_get_int(args[1]);
-	point_t result = rl_array_argmin(self->array, blocking);
-	mp_obj_tuple_t *tuple = MP_OBJ_TO_PTR(mp_obj_new_tuple(2, NULL));
-	tuple->items[0] = mp_obj_new_int(result.x);
-	tuple->items[1] = mp_obj_new_int(result.y);
-	return tuple;
+STATIC mp_obj_t mod_rl_array_max(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_blocking, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_axis, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, blocking, axis, mask, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+	return mod_rl_array_reduce(REDUCE_MAX, args.self.u_obj, args.blocking.u_obj, args.axis.u_obj, args.mask.u_obj, args.out.u_obj);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_argmin_obj, 1, 2, mod_rl_array_argmin);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_max_obj, 1, mod_rl_array_max);
 
-STATIC mp_obj_t mod_rl_array_argmax(size_t n_args, const mp_obj_t *args) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_int_t blocking = VALUE_MAX;
-	if(n_args > 1) blocking = mp_obj_get_int(args[1]);
-	point_t result = rl_array_argmax(self->array, blocking);
-	mp_obj_tuple_t *tuple = MP_OBJ_TO_PTR(mp_obj_new_tuple(2, NULL));
-	tuple->items[0] = mp_obj_new_int(result.x);
-	tuple->items[1] = mp_obj_new_int(result.y);
-	return tuple;
+STATIC mp_obj_t mod_rl_array_argminmax(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args, int is_max) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_blocking, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, blocking, mask;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	double blocking = VALUE_MAX;
+	if(args.blocking.u_obj != mp_const_none) blocking = mod_rl_array_scalar(self->array, args.blocking.u_obj);
+	array_t* mask = mod_rl_array_get_mask(args.mask.u_obj);
+	point_t result = is_max ? rl_array_argmax(self->array, blocking, mask) : rl_array_argmin(self->array, blocking, mask);
+	mp_obj_t items[2] = {mp_obj_new_int(result.x), mp_obj_new_int(result.y)};
+	return mp_obj_new_tuple(2, items);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_argmax_obj, 1, 2, mod_rl_array_argmax);
+
+STATIC mp_obj_t mod_rl_array_argmin(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	return mod_rl_array_argminmax(n_args, pos_args, kw_args, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_argmin_obj, 1, mod_rl_array_argmin);
+
+STATIC mp_obj_t mod_rl_array_argmax(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	return mod_rl_array_argminmax(n_args, pos_args, kw_args, 1);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_argmax_obj, 1, mod_rl_array_argmax);
 
 STATIC mp_obj_t mod_rl_array_find_random(size_t n_args, const mp_obj_t *args) {
 	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
@@ -799,31 +1191,65 @@ STATIC mp_obj_t mod_rl_array_view(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_view_obj, 5, 5, mod_rl_array_view);
 
-STATIC mp_obj_t mod_rl_array_copy(size_t n_args, const mp_obj_t *args) {
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
-	array_t* mask = NULL;
-	if(n_args > 1) {
-		if(!mp_obj_is_type(args[1], &mp_type_rl_array)) 
-			mp_raise_msg(&mp_type_TypeError, "mask should be of type array");
-		mp_obj_rl_array_t* obj_mask = MP_OBJ_TO_PTR(args[1]);
-		mask = obj_mask->array;
+STATIC mp_obj_t mod_rl_array_copy(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, mask, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	mp_obj_t mask_in = args.mask.u_obj;
+	if(mask_in != mp_const_none && !mp_obj_is_type(mask_in, &mp_type_rl_array) && !mp_obj_is_type(mask_in, &mp_type_rl_bitmask))
+		mp_raise_msg(&mp_type_TypeError, "mask should be of type array or bitmask");
+	if(args.out.u_obj != mp_const_none) {
+		mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, self->array->dtype);
+		mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+		if(mp_obj_is_type(mask_in, &mp_type_rl_bitmask)) {
+			mp_obj_rl_bitmask_t* obj_mask = MP_OBJ_TO_PTR(mask_in);
+			rl_array_copy_bitmask_into(self->array, output->array, obj_mask->bitmask);
+		} else {
+			array_t* mask = mask_in == mp_const_none ? NULL : ((mp_obj_rl_array_t*) MP_OBJ_TO_PTR(mask_in))->array;
+			rl_array_copy_into(self->array, output->array, mask);
+		}
+		return output_in;
 	}
 	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
 	output->base.type = &mp_type_rl_array;
+	if(mp_obj_is_type(mask_in, &mp_type_rl_bitmask)) {
+		mp_obj_rl_bitmask_t* obj_mask = MP_OBJ_TO_PTR(mask_in);
+		output->array = rl_array_copy_bitmask(self->array, obj_mask->bitmask);
+		return MP_OBJ_FROM_PTR(output);
+	}
+	array_t* mask = NULL;
+	if(mask_in != mp_const_none) {
+		mp_obj_rl_array_t* obj_mask = MP_OBJ_TO_PTR(mask_in);
+		mask = obj_mask->array;
+	}
 	output->array = rl_array_copy(self->array, mask);
 	return MP_OBJ_FROM_PTR(output);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_copy_obj, 1, 2, mod_rl_array_copy);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_copy_obj, 1, mod_rl_array_copy);
 
 STATIC mp_obj_t mod_rl_array_copy_to(size_t n_args, const mp_obj_t *args) {
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
 	if(!mp_obj_is_type(args[1], &mp_type_rl_array)) 
 		mp_raise_msg(&mp_type_TypeError, "dest should be of type array");
 	mp_obj_rl_array_t *dest = MP_OBJ_TO_PTR(args[1]);
+	if(n_args > 2 && mp_obj_is_type(args[2], &mp_type_rl_bitmask)) {
+		mp_obj_rl_bitmask_t* obj_mask = MP_OBJ_TO_PTR(args[2]);
+		rl_array_copy_to_bitmask(self->array, dest->array, obj_mask->bitmask);
+		return mp_const_none;
+	}
 	array_t* mask = NULL;
 	if(n_args > 2) {
 		if(!mp_obj_is_type(args[2], &mp_type_rl_array)) 
-			mp_raise_msg(&mp_type_TypeError, "mask should be of type array");
+			mp_raise_msg(&mp_type_TypeError, "mask should be of type array or bitmask");
 		mp_obj_rl_array_t* obj_mask = MP_OBJ_TO_PTR(args[2]);
 		mask = obj_mask->array;
 	}
@@ -832,55 +1258,178 @@ STATIC mp_obj_t mod_rl_array_copy_to(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_copy_to_obj, 2, 3, mod_rl_array_copy_to);
 
-STATIC mp_obj_t mod_rl_array_cell_automaton(size_t n_args, const mp_obj_t *args) {
-	mp_check_self(mp_obj_is_type(args[0], &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
+STATIC mp_obj_t mod_rl_array_cell_automaton(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_definition, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_warp, MP_ARG_BOOL, {.u_bool = false} },
+		{ MP_QSTR_iterations, MP_ARG_INT, {.u_int = 1} },
+	};
+	struct {
+		mp_arg_val_t self, definition, warp, iterations;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
 	size_t len;
-	const char *definition = mp_obj_str_get_data(args[1], &len);
-	mp_int_t wrap = 0;
-	if(n_args > 2) wrap = mp_obj_get_int(args[2]);
-  rl_array_cell_automaton(self->array, definition, wrap);
+	const char *definition = mp_obj_str_get_data(args.definition.u_obj, &len);
+	rl_array_cell_automaton(self->array, definition, args.warp.u_bool, args.iterations.u_int);
 	return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_cell_automaton_obj, 2, 3, mod_rl_array_cell_automaton);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_cell_automaton_obj, 2, mod_rl_array_cell_automaton);
 
-STATIC mp_obj_t mod_rl_array_count(mp_obj_t self_in, mp_obj_t value_in) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_int_t value = mp_obj_get_int(value_in);
-	mp_int_t result = rl_array_count(self->array, value);
+STATIC mp_obj_t mod_rl_array_count(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_value, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, value, mask;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	array_t* mask = mod_rl_array_get_mask(args.mask.u_obj);
+	mp_int_t result = rl_array_count(self->array, mod_rl_array_scalar(self->array, args.value.u_obj), mask);
 	return mp_obj_new_int(result);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_count_obj, mod_rl_array_count);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_count_obj, 2, mod_rl_array_count);
 
-STATIC mp_obj_t mod_rl_array_sum(mp_obj_t self_in) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_int_t result = rl_array_sum(self->array);
-	return mp_obj_new_int(result);
+STATIC mp_obj_t mod_rl_array_sum(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_axis, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, axis, mask, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+	return mod_rl_array_reduce(REDUCE_SUM, args.self.u_obj, mp_const_none, args.axis.u_obj, args.mask.u_obj, args.out.u_obj);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_array_sum_obj, mod_rl_array_sum);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_sum_obj, 1, mod_rl_array_sum);
 
-STATIC mp_obj_t mod_rl_array_apply_kernel(mp_obj_t self_in, mp_obj_t kernel_in) {
-	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_array));
-	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(self_in);
-	if(!mp_obj_is_type(kernel_in, &mp_type_rl_array))
+STATIC mp_obj_t mod_rl_array_histogram(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_bins, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, bins, mask;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(args.bins.u_int < 0)
+		mp_raise_msg(&mp_type_ValueError, "bins should not be negative");
+	array_t* mask = mod_rl_array_get_mask(args.mask.u_obj);
+	// on the gc heap, the histogram and the list below can raise
+	uint32_t* counts = m_new(uint32_t, args.bins.u_int > 0 ? args.bins.u_int : 1);
+	rl_array_histogram(self->array, args.bins.u_int, counts, mask);
+	mp_obj_t list = mp_obj_new_list(args.bins.u_int, NULL);
+	mp_obj_list_t* items = MP_OBJ_TO_PTR(list);
+	for(int i = 0; i < args.bins.u_int; i++) items->items[i] = mp_obj_new_int(counts[i]);
+	m_del(uint32_t, counts, args.bins.u_int > 0 ? args.bins.u_int : 1);
+	return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_histogram_obj, 2, mod_rl_array_histogram);
+
+STATIC mp_obj_t mod_rl_array_unique(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_mask, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, mask;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	array_t* mask = mod_rl_array_get_mask(args.mask.u_obj);
+	value_counts_t* unique = rl_array_unique(self->array, mask);
+	// allocating the lists can raise, unique is released before propagating
+	mp_obj_t result[2];
+	nlr_buf_t nlr;
+	if(nlr_push(&nlr) == 0) {
+		result[0] = mp_obj_new_list(unique->size, NULL);
+		result[1] = mp_obj_new_list(unique->size, NULL);
+		mp_obj_list_t* value_items = MP_OBJ_TO_PTR(result[0]);
+		mp_obj_list_t* count_items = MP_OBJ_TO_PTR(result[1]);
+		for(int i = 0; i < unique->size; i++) {
+			value_items->items[i] = mod_rl_array_new_scalar(self->array, unique->values[i].value);
+			count_items->items[i] = mp_obj_new_int(unique->values[i].count);
+		}
+		nlr_pop();
+	} else {
+		free(unique);
+		nlr_jump(nlr.ret_val);
+	}
+	free(unique);
+	return mp_obj_new_tuple(2, result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_unique_obj, 1, mod_rl_array_unique);
+
+STATIC mp_obj_t mod_rl_array_apply_kernel(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_kernel, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, kernel, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(!mp_obj_is_type(args.kernel.u_obj, &mp_type_rl_array))
 		mp_raise_msg(&mp_type_TypeError, "expected array");
-	mp_obj_rl_array_t *kernel = MP_OBJ_TO_PTR(kernel_in);
+	mp_obj_rl_array_t *kernel = MP_OBJ_TO_PTR(args.kernel.u_obj);
 
-	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
-	output->base.type = &mp_type_rl_array;
-	output->array = rl_array_apply_kernel(self->array, kernel->array);
-	return MP_OBJ_FROM_PTR(output);
+	mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, DTYPE_INT32);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	rl_array_apply_kernel_into(self->array, output->array, kernel->array);
+	return output_in;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_apply_kernel_obj, 2, mod_rl_array_apply_kernel);
+
+STATIC mp_obj_t mod_rl_array_matmul(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_other, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, other, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(!mp_obj_is_type(args.other.u_obj, &mp_type_rl_array))
+		mp_raise_msg(&mp_type_TypeError, "expected array");
+	mp_obj_rl_array_t *other = MP_OBJ_TO_PTR(args.other.u_obj);
+
+	mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, other->array->width, self->array->height, DTYPE_INT32);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	rl_array_matmul_into(self->array, output->array, other->array);
+	return output_in;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_array_apply_kernel_obj, mod_rl_array_apply_kernel);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_matmul_obj, 2, mod_rl_array_matmul);
 
 STATIC mp_obj_t mod_rl_array_flood_fill(size_t n_args, const mp_obj_t *args) {
 	mp_check_self(mp_obj_is_type(args[0], &mp_type_rl_array));
 	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args[0]);
 	mp_int_t x = mp_obj_get_int(args[1]);
 	mp_int_t y = mp_obj_get_int(args[2]);
-	mp_int_t value = mp_obj_get_int(args[3]);
+	double value = mod_rl_array_scalar(self->array, args[3]);
 	mp_int_t use_diagonals = 0;
 	if(n_args > 4) use_diagonals = mp_obj_is_true(args[4]);
 	mp_int_t result = rl_array_flood_fill(self->array, x, y, value, use_diagonals);
@@ -888,13 +1437,90 @@ STATIC mp_obj_t mod_rl_array_flood_fill(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_array_flood_fill_obj, 4, 5, mod_rl_array_flood_fill);
 
+STATIC mp_obj_t mod_rl_array_label_components(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_value, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_use_diagonals, MP_ARG_BOOL, {.u_bool = false} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, value, use_diagonals, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	int has_value = args.value.u_obj != mp_const_none;
+	double value = has_value ? mod_rl_array_scalar(self->array, args.value.u_obj) : 0;
+	mp_obj_t labels_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, DTYPE_INT32);
+	mp_obj_rl_array_t* labels = MP_OBJ_TO_PTR(labels_in);
+	components_t* components = rl_array_label_components(self->array, labels->array, args.use_diagonals.u_bool, has_value, value);
+	// allocating the list can raise, components are released before propagating
+	mp_obj_t result[2] = {labels_in, MP_OBJ_NULL};
+	nlr_buf_t nlr;
+	if(nlr_push(&nlr) == 0) {
+		result[1] = mp_obj_new_list(components->size, NULL);
+		mp_obj_list_t* items = MP_OBJ_TO_PTR(result[1]);
+		for(int i = 0; i < components->size; i++) {
+			component_t* c = &components->components[i];
+			mp_obj_t fields[5] = {mp_obj_new_int(c->size), mp_obj_new_int(c->x), mp_obj_new_int(c->y), mp_obj_new_int(c->width), mp_obj_new_int(c->height)};
+			items->items[i] = mp_obj_new_tuple(5, fields);
+		}
+		nlr_pop();
+	} else {
+		free(components);
+		nlr_jump(nlr.ret_val);
+	}
+	free(components);
+	return mp_obj_new_tuple(2, result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_label_components_obj, 1, mod_rl_array_label_components);
+
+STATIC mp_obj_t mod_rl_array_distance_transform(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_value, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_INT(1)} },
+		{ MP_QSTR_metric, MP_ARG_INT, {.u_int = DISTANCE_EUCLIDEAN} },
+		{ MP_QSTR_nearest, MP_ARG_BOOL, {.u_bool = false} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, value, metric, nearest, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_array));
+	mp_obj_rl_array_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(args.metric.u_int < DISTANCE_EUCLIDEAN || args.metric.u_int > DISTANCE_MANHATTAN)
+		mp_raise_msg(&mp_type_ValueError, "unknown distance metric");
+	double value = mod_rl_array_scalar(self->array, args.value.u_obj);
+	int dtype = args.metric.u_int == DISTANCE_EUCLIDEAN ? DTYPE_FLOAT32 : DTYPE_INT32;
+	mp_obj_t output_in = mod_rl_array_get_out(args.out.u_obj, self->array->width, self->array->height, dtype);
+	mp_obj_rl_array_t* output = MP_OBJ_TO_PTR(output_in);
+	if(!args.nearest.u_bool) {
+		rl_array_distance_transform_into(self->array, output->array, value, args.metric.u_int, NULL, NULL);
+		return output_in;
+	}
+	mp_obj_t result[3] = {output_in,
+		mod_rl_array_get_out(mp_const_none, self->array->width, self->array->height, DTYPE_INT32),
+		mod_rl_array_get_out(mp_const_none, self->array->width, self->array->height, DTYPE_INT32)};
+	mp_obj_rl_array_t* nearest_x = MP_OBJ_TO_PTR(result[1]);
+	mp_obj_rl_array_t* nearest_y = MP_OBJ_TO_PTR(result[2]);
+	rl_array_distance_transform_into(self->array, output->array, value, args.metric.u_int, nearest_x->array, nearest_y->array);
+	return mp_obj_new_tuple(3, result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_array_distance_transform_obj, 1, mod_rl_array_distance_transform);
+
 STATIC const mp_rom_map_elem_t mod_rl_array_locals_dict_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_to_string), MP_ROM_PTR(&mod_rl_array_to_string_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_to_bytes), MP_ROM_PTR(&mod_rl_array_to_bytes_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_view), MP_ROM_PTR(&mod_rl_array_view_obj) },
 	/*{ MP_ROM_QSTR(MP_QSTR_get), MP_ROM_PTR(&mod_rl_array_get_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_set), MP_ROM_PTR(&mod_rl_array_set_obj) },*/
 	{ MP_ROM_QSTR(MP_QSTR_width), MP_ROM_PTR(&mod_rl_array_width_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_height), MP_ROM_PTR(&mod_rl_array_height_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_dtype), MP_ROM_PTR(&mod_rl_array_dtype_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_print_ascii), MP_ROM_PTR(&mod_rl_array_print_ascii_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_fill), MP_ROM_PTR(&mod_rl_array_fill_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_replace), MP_ROM_PTR(&mod_rl_array_replace_obj) },
@@ -906,6 +1532,7 @@ STATIC const mp_rom_map_elem_t mod_rl_array_locals_dict_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_fill_rect), MP_ROM_PTR(&mod_rl_array_fill_rect_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_can_see), MP_ROM_PTR(&mod_rl_array_can_see_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_field_of_view), MP_ROM_PTR(&mod_rl_array_field_of_view_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_field_of_view_batch), MP_ROM_PTR(&mod_rl_array_field_of_view_batch_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_dijkstra), MP_ROM_PTR(&mod_rl_array_dijkstra_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_cell_automaton), MP_ROM_PTR(&mod_rl_array_cell_automaton_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_shortest_path), MP_ROM_PTR(&mod_rl_array_shortest_path_obj) },
@@ -918,22 +1545,50 @@ STATIC const mp_rom_map_elem_t mod_rl_array_locals_dict_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_copy_to), MP_ROM_PTR(&mod_rl_array_copy_to_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_equals), MP_ROM_PTR(&mod_rl_array_equals_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_not_equals), MP_ROM_PTR(&mod_rl_array_not_equals_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_greater), MP_ROM_PTR(&mod_rl_array_greater_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_less), MP_ROM_PTR(&mod_rl_array_less_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_greater_equal), MP_ROM_PTR(&mod_rl_array_greater_equal_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_less_equal), MP_ROM_PTR(&mod_rl_array_less_equal_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_bitwise_and), MP_ROM_PTR(&mod_rl_array_bitwise_and_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_bitwise_or), MP_ROM_PTR(&mod_rl_array_bitwise_or_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_bitwise_xor), MP_ROM_PTR(&mod_rl_array_bitwise_xor_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_left_shift), MP_ROM_PTR(&mod_rl_array_left_shift_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_right_shift), MP_ROM_PTR(&mod_rl_array_right_shift_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_add), MP_ROM_PTR(&mod_rl_array_add_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_subtract), MP_ROM_PTR(&mod_rl_array_subtract_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_multiply), MP_ROM_PTR(&mod_rl_array_multiply_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_divide), MP_ROM_PTR(&mod_rl_array_divide_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_mod), MP_ROM_PTR(&mod_rl_array_mod_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_negative), MP_ROM_PTR(&mod_rl_array_negative_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_invert), MP_ROM_PTR(&mod_rl_array_invert_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_absolute), MP_ROM_PTR(&mod_rl_array_absolute_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&mod_rl_array_count_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_sum), MP_ROM_PTR(&mod_rl_array_sum_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_histogram), MP_ROM_PTR(&mod_rl_array_histogram_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_unique), MP_ROM_PTR(&mod_rl_array_unique_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_apply_kernel), MP_ROM_PTR(&mod_rl_array_apply_kernel_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_matmul), MP_ROM_PTR(&mod_rl_array_matmul_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_flood_fill), MP_ROM_PTR(&mod_rl_array_flood_fill_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_label_components), MP_ROM_PTR(&mod_rl_array_label_components_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_distance_transform), MP_ROM_PTR(&mod_rl_array_distance_transform_obj) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mod_rl_array_locals_dict, mod_rl_array_locals_dict_table);
 
-STATIC mp_obj_t mod_rl_array_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+STATIC mp_obj_t mod_rl_array_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
 	(void)type_in;
-	mp_arg_check_num(n_args, n_kw, 2, 2, false);
-	mp_int_t width = mp_obj_get_int(args[0]);
-	mp_int_t height = mp_obj_get_int(args[1]);
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_width, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_height, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_dtype, MP_ARG_INT, {.u_int = DTYPE_INT32} },
+	};
+	struct {
+		mp_arg_val_t width, height, dtype;
+	} args;
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
 	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
 	output->base.type = &mp_type_rl_array;
-	output->array = rl_array_new(width, height);
+	output->array = rl_array_new_dtype(args.width.u_int, args.height.u_int, args.dtype.u_int);
 	return MP_OBJ_FROM_PTR(output);
 }
 
@@ -952,7 +1607,7 @@ STATIC mp_obj_t mod_rl_array_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
 		case MP_UNARY_OP_INVERT: {
 			mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
 			output->base.type = &mp_type_rl_array;
-			output->array = rl_array_unary_minus(self->array);
+			output->array = rl_array_unary_invert(self->array);
 			return MP_OBJ_FROM_PTR(output);
 		}
 		case MP_UNARY_OP_BOOL:
@@ -975,21 +1630,32 @@ STATIC mp_obj_t mod_rl_array_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
 							mp_obj_rl_array_t *rhs = MP_OBJ_TO_PTR(rhs_in); \
               output->array = rl_array_##side##_##name##_other(lhs->array, rhs->array); \
             } else { \
-              output->array = rl_array_##side##_##name##_value(lhs->array, mp_obj_get_int(rhs_in)); \
+              output->array = rl_array_##side##_##name##_value(lhs->array, mod_rl_array_scalar(lhs->array, rhs_in)); \
 						} \
 						return MP_OBJ_FROM_PTR(output); \
         }
 #define mod_rl_array_op(OP, name) \
 	mod_rl_array_op_side(MP_BINARY_OP_##OP, right, name)
 
+// in-place operators modify the left operand instead of allocating a new array
 #define mod_rl_array_op_inplace(OP, name) \
 	mod_rl_array_op_side(MP_BINARY_OP_##OP, right, name) \
 	mod_rl_array_op_side(MP_BINARY_OP_REVERSE_##OP, left, name) \
-	mod_rl_array_op_side(MP_BINARY_OP_INPLACE_##OP, right, name)
+	case MP_BINARY_OP_INPLACE_##OP: { \
+		if(rhs_is_array) { \
+			mp_obj_rl_array_t *rhs = MP_OBJ_TO_PTR(rhs_in); \
+			rl_array_inplace_##name##_other(lhs->array, rhs->array); \
+		} else { \
+			rl_array_inplace_##name##_value(lhs->array, mod_rl_array_scalar(lhs->array, rhs_in)); \
+		} \
+		return lhs_in; \
+	}
 
 STATIC mp_obj_t mod_rl_array_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in) {
     mp_obj_rl_array_t *lhs = MP_OBJ_TO_PTR(lhs_in);
     int rhs_is_array = mp_obj_is_type(rhs_in, &mp_type_rl_array);
+		// expressions handle the reversed operator
+		if(mp_obj_is_type(rhs_in, &mp_type_rl_expr)) return MP_OBJ_NULL;
 		//printf("op: %d %p %p\n", op, lhs_in, rhs_in);
     switch (op) {
 			// not supported due to bug in micropython
@@ -1009,6 +1675,17 @@ STATIC mp_obj_t mod_rl_array_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_ob
 			mod_rl_array_op_inplace(MULTIPLY, mul);
 			mod_rl_array_op_inplace(TRUE_DIVIDE, div);
 			mod_rl_array_op_inplace(MODULO, mod);
+#if MICROPY_VERSION_MAJOR > 1 || MICROPY_VERSION_MINOR >= 12
+			// the @ operator appeared in micropython 1.12
+			case MP_BINARY_OP_MAT_MULTIPLY: {
+				if(!rhs_is_array) return MP_OBJ_NULL;
+				mp_obj_rl_array_t *rhs = MP_OBJ_TO_PTR(rhs_in);
+				mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+				output->base.type = &mp_type_rl_array;
+				output->array = rl_array_matmul(lhs->array, rhs->array);
+				return MP_OBJ_FROM_PTR(output);
+			}
+#endif
 			default:
 				return MP_OBJ_NULL; // op not supported
     }
@@ -1022,21 +1699,547 @@ const mp_obj_type_t mp_type_rl_array = {
 	.unary_op = mod_rl_array_unary_op,
 	.binary_op = mod_rl_array_binary_op,
 	.subscr = mod_rl_array_subscr,
+	.buffer_p = { .get_buffer = mod_rl_array_get_buffer },
 	//.getiter = list_getiter,
 	.locals_dict = (mp_obj_dict_t*)&mod_rl_array_locals_dict,
 };
 
+/************* distance map ******************/
+
+extern const mp_obj_type_t mp_type_rl_distance_map;
+
+typedef struct {
+	mp_obj_base_t base;
+	distance_map_t* map;
+} mp_obj_rl_distance_map_t;
+
+STATIC mp_obj_t mod_rl_distance_map_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+	(void)type_in;
+	mp_arg_check_num(n_args, n_kw, 1, 2, false);
+	if(!mp_obj_is_type(args[0], &mp_type_rl_array)) 
+		mp_raise_msg(&mp_type_TypeError, "level should be of type array");
+	mp_obj_rl_array_t *level = MP_OBJ_TO_PTR(args[0]);
+	mp_int_t blocking = 1;
+	if(n_args > 1) blocking = mp_obj_get_int(args[1]);
+	mp_obj_rl_distance_map_t* output = m_new_obj(mp_obj_rl_distance_map_t);
+	output->base.type = &mp_type_rl_distance_map;
+	output->map = rl_distance_map_new(level->array, blocking);
+	return MP_OBJ_FROM_PTR(output);
+}
+
+STATIC mp_obj_t mod_rl_distance_map_add_goal(mp_obj_t self_in, mp_obj_t x_in, mp_obj_t y_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_distance_map));
+	mp_obj_rl_distance_map_t *self = MP_OBJ_TO_PTR(self_in);
+	rl_distance_map_add_goal(self->map, mp_obj_get_int(x_in), mp_obj_get_int(y_in));
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mod_rl_distance_map_add_goal_obj, mod_rl_distance_map_add_goal);
+
+STATIC mp_obj_t mod_rl_distance_map_remove_goal(mp_obj_t self_in, mp_obj_t x_in, mp_obj_t y_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_distance_map));
+	mp_obj_rl_distance_map_t *self = MP_OBJ_TO_PTR(self_in);
+	rl_distance_map_remove_goal(self->map, mp_obj_get_int(x_in), mp_obj_get_int(y_in));
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mod_rl_distance_map_remove_goal_obj, mod_rl_distance_map_remove_goal);
+
+STATIC mp_obj_t mod_rl_distance_map_set_blocking(size_t n_args, const mp_obj_t *args) {
+	mp_check_self(mp_obj_is_type(args[0], &mp_type_rl_distance_map));
+	mp_obj_rl_distance_map_t *self = MP_OBJ_TO_PTR(args[0]);
+	mp_int_t x = mp_obj_get_int(args[1]);
+	mp_int_t y = mp_obj_get_int(args[2]);
+	mp_int_t is_blocking = 1;
+	if(n_args > 3) is_blocking = mp_obj_is_true(args[3]);
+	rl_distance_map_set_blocking(self->map, x, y, is_blocking);
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_distance_map_set_blocking_obj, 3, 4, mod_rl_distance_map_set_blocking);
+
+STATIC mp_obj_t mod_rl_distance_map_array(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_distance_map));
+	mp_obj_rl_distance_map_t *self = MP_OBJ_TO_PTR(self_in);
+	array_t* distances = self->map->distances;
+	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+	output->base.type = &mp_type_rl_array;
+	output->array = rl_array_view(distances, 0, 0, distances->width, distances->height);
+	return MP_OBJ_FROM_PTR(output);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_distance_map_array_obj, mod_rl_distance_map_array);
+
+STATIC const mp_rom_map_elem_t mod_rl_distance_map_locals_dict_table[] = {
+	{ MP_ROM_QSTR(MP_QSTR_add_goal), MP_ROM_PTR(&mod_rl_distance_map_add_goal_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_remove_goal), MP_ROM_PTR(&mod_rl_distance_map_remove_goal_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_set_blocking), MP_ROM_PTR(&mod_rl_distance_map_set_blocking_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_array), MP_ROM_PTR(&mod_rl_distance_map_array_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mod_rl_distance_map_locals_dict, mod_rl_distance_map_locals_dict_table);
+
+const mp_obj_type_t mp_type_rl_distance_map = {
+	{ &mp_type_type },
+	.name = MP_QSTR_DistanceMap,
+	.make_new = mod_rl_distance_map_make_new,
+	.locals_dict = (mp_obj_dict_t*)&mod_rl_distance_map_locals_dict,
+};
+
+/************* bitmask ******************/
+
+STATIC mp_obj_t mod_rl_bitmask_wrap(bitmask_t* bitmask) {
+	mp_obj_rl_bitmask_t* output = m_new_obj(mp_obj_rl_bitmask_t);
+	output->base.type = &mp_type_rl_bitmask;
+	output->bitmask = bitmask;
+	return MP_OBJ_FROM_PTR(output);
+}
+
+STATIC mp_obj_t mod_rl_bitmask_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+	(void)type_in;
+	mp_arg_check_num(n_args, n_kw, 2, 2, false);
+	mp_int_t width = mp_obj_get_int(args[0]);
+	mp_int_t height = mp_obj_get_int(args[1]);
+	return mod_rl_bitmask_wrap(rl_bitmask_new(width, height));
+}
+
+STATIC mp_obj_t mod_rl_bitmask_from_array(size_t n_args, const mp_obj_t *args) {
+	if(!mp_obj_is_type(args[0], &mp_type_rl_array)) 
+		mp_raise_msg(&mp_type_TypeError, "expected array");
+	mp_obj_rl_array_t *array = MP_OBJ_TO_PTR(args[0]);
+	bitmask_t* bitmask = rl_bitmask_new(array->array->width, array->array->height);
+	if(n_args > 1 && args[1] != mp_const_none) rl_bitmask_from_array_equal(bitmask, array->array, mod_rl_array_scalar(array->array, args[1]));
+	else rl_bitmask_from_array(bitmask, array->array);
+	return mod_rl_bitmask_wrap(bitmask);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_bitmask_from_array_obj, 1, 2, mod_rl_bitmask_from_array);
+
+STATIC void mod_rl_bitmask_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_t kind) {
+	mp_obj_rl_bitmask_t *o = MP_OBJ_TO_PTR(o_in);
+	bitmask_t* m = o->bitmask;
+	mp_print_str(print, "Bitmask[");
+	for(int j = 0; j < m->height; j++) {
+		mp_print_str(print, "[");
+		for(int i = 0; i < m->width; i++) {
+			if(i > 0) mp_print_str(print, ", ");
+			mp_printf(print, "%d", (int) rl_bitmask_value(m, i, j));
+		}
+		if(j < m->height - 1) mp_print_str(print, "], ");
+		else mp_print_str(print, "]");
+	}
+	mp_print_str(print, "]");
+}
+
+STATIC mp_obj_t mod_rl_bitmask_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	if(!mp_obj_is_type(index_in, &mp_type_tuple))
+		mp_raise_msg(&mp_type_TypeError, "subscript index should be a tuple");
+	mp_obj_tuple_t* index = MP_OBJ_TO_PTR(index_in);
+	if(index->len != 2) 
+		mp_raise_msg(&mp_type_IndexError, "rl_bitmask subscripts only supports 2-dim indexing");
+	if(mp_obj_is_type(index->items[0], &mp_type_slice) || mp_obj_is_type(index->items[1], &mp_type_slice)) {
+		// support for making a view from slices
+		mp_bound_slice_t i, j;
+		if(mp_obj_is_type(index->items[0], &mp_type_slice))
+			mp_seq_get_fast_slice_indexes(self->bitmask->width, index->items[0], &i);
+		else {
+			mp_int_t start = mp_obj_get_int(index->items[0]);
+			if(start < 0) start += self->bitmask->width;
+			i.start = start;
+			i.stop = start + 1;
+			i.step = 1;
+		}
+		if(mp_obj_is_type(index->items[1], &mp_type_slice))
+			mp_seq_get_fast_slice_indexes(self->bitmask->height, index->items[1], &j);
+		else {
+			mp_int_t start = mp_obj_get_int(index->items[1]);
+			if(start < 0) start += self->bitmask->height;
+			j.start = start;
+			j.stop = start + 1;
+			j.step = 1;
+		}
+		if(i.step != 1 || j.step != 1)
+			mp_raise_msg(&mp_type_IndexError, "only slices of step 1 supported");
+		bitmask_t* view = rl_bitmask_view(self->bitmask, i.start, j.start, i.stop - i.start, j.stop - j.start);
+		if(value_in == MP_OBJ_SENTINEL) { // get
+			return mod_rl_bitmask_wrap(view);
+		} else { // set
+			if(mp_obj_is_type(value_in, &mp_type_rl_bitmask)) {
+				mp_obj_rl_bitmask_t* other = MP_OBJ_TO_PTR(value_in);
+				rl_bitmask_copy_to(other->bitmask, view);
+			} else {
+				rl_bitmask_fill(view, mp_obj_is_true(value_in));
+			}
+			rl_bitmask_free(view);
+			return mp_const_none;
+		}
+	} else {
+		// regular indexing with integers
+		mp_int_t i = mp_obj_get_int(index->items[0]);
+		mp_int_t j = mp_obj_get_int(index->items[1]);
+		if(i < 0) i += self->bitmask->width;
+		if(j < 0) j += self->bitmask->height;
+		if(value_in == MP_OBJ_SENTINEL) { // get
+			return mp_obj_new_bool(rl_bitmask_get(self->bitmask, i, j));
+		} else { // set
+			rl_bitmask_set(self->bitmask, i, j, mp_obj_is_true(value_in));
+			return mp_const_none;
+		}
+	}
+	return MP_OBJ_NULL;
+}
+
+STATIC mp_obj_t mod_rl_bitmask_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	switch (op) {
+		case MP_UNARY_OP_INVERT: {
+			bitmask_t* result = rl_bitmask_new(self->bitmask->width, self->bitmask->height);
+			rl_bitmask_not(result, self->bitmask);
+			return mod_rl_bitmask_wrap(result);
+		}
+		case MP_UNARY_OP_BOOL:
+			return mp_obj_new_bool(rl_bitmask_any(self->bitmask));
+		default: return MP_OBJ_NULL; // op not supported
+	}
+}
+
+#define mod_rl_bitmask_op(OP, name) \
+	case MP_BINARY_OP_##OP: { \
+		bitmask_t* result = rl_bitmask_new(lhs->bitmask->width, lhs->bitmask->height); \
+		rl_bitmask_##name(result, lhs->bitmask, rhs->bitmask); \
+		return mod_rl_bitmask_wrap(result); \
+	} \
+	case MP_BINARY_OP_INPLACE_##OP: \
+		rl_bitmask_##name(lhs->bitmask, lhs->bitmask, rhs->bitmask); \
+		return lhs_in;
+
+STATIC mp_obj_t mod_rl_bitmask_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in) {
+	if(!mp_obj_is_type(rhs_in, &mp_type_rl_bitmask)) return MP_OBJ_NULL; // op not supported
+	mp_obj_rl_bitmask_t *lhs = MP_OBJ_TO_PTR(lhs_in);
+	mp_obj_rl_bitmask_t *rhs = MP_OBJ_TO_PTR(rhs_in);
+	switch (op) {
+		mod_rl_bitmask_op(AND, and);
+		mod_rl_bitmask_op(OR, or);
+		mod_rl_bitmask_op(XOR, xor);
+		default:
+			return MP_OBJ_NULL; // op not supported
+	}
+}
+
+STATIC mp_obj_t mod_rl_bitmask_width(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(self->bitmask->width);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_width_obj, mod_rl_bitmask_width);
+
+STATIC mp_obj_t mod_rl_bitmask_height(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(self->bitmask->height);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_height_obj, mod_rl_bitmask_height);
+
+STATIC mp_obj_t mod_rl_bitmask_fill(mp_obj_t self_in, mp_obj_t value_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	rl_bitmask_fill(self->bitmask, mp_obj_is_true(value_in));
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_bitmask_fill_obj, mod_rl_bitmask_fill);
+
+STATIC mp_obj_t mod_rl_bitmask_count(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(rl_bitmask_count(self->bitmask));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_count_obj, mod_rl_bitmask_count);
+
+STATIC mp_obj_t mod_rl_bitmask_any(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_bool(rl_bitmask_any(self->bitmask));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_any_obj, mod_rl_bitmask_any);
+
+STATIC mp_obj_t mod_rl_bitmask_all(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_bool(rl_bitmask_all(self->bitmask));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_all_obj, mod_rl_bitmask_all);
+
+STATIC mp_obj_t mod_rl_bitmask_copy(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	bitmask_t* result = rl_bitmask_new(self->bitmask->width, self->bitmask->height);
+	rl_bitmask_copy_to(self->bitmask, result);
+	return mod_rl_bitmask_wrap(result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_copy_obj, mod_rl_bitmask_copy);
+
+STATIC mp_obj_t mod_rl_bitmask_to_array(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+	output->base.type = &mp_type_rl_array;
+	output->array = rl_array_new(self->bitmask->width, self->bitmask->height);
+	rl_bitmask_to_array(self->bitmask, output->array);
+	return MP_OBJ_FROM_PTR(output);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_bitmask_to_array_obj, mod_rl_bitmask_to_array);
+
+STATIC mp_obj_t mod_rl_bitmask_flood_fill(size_t n_args, const mp_obj_t *args) {
+	mp_check_self(mp_obj_is_type(args[0], &mp_type_rl_bitmask));
+	mp_obj_rl_bitmask_t *self = MP_OBJ_TO_PTR(args[0]);
+	mp_int_t x = mp_obj_get_int(args[1]);
+	mp_int_t y = mp_obj_get_int(args[2]);
+	mp_int_t value = mp_obj_is_true(args[3]);
+	mp_int_t use_diagonals = 0;
+	if(n_args > 4) use_diagonals = mp_obj_is_true(args[4]);
+	mp_int_t result = rl_bitmask_flood_fill(self->bitmask, x, y, value, use_diagonals);
+	return mp_obj_new_int(result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_bitmask_flood_fill_obj, 4, 5, mod_rl_bitmask_flood_fill);
+
+STATIC const mp_rom_map_elem_t mod_rl_bitmask_locals_dict_table[] = {
+	{ MP_ROM_QSTR(MP_QSTR_width), MP_ROM_PTR(&mod_rl_bitmask_width_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_height), MP_ROM_PTR(&mod_rl_bitmask_height_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_fill), MP_ROM_PTR(&mod_rl_bitmask_fill_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&mod_rl_bitmask_count_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_any), MP_ROM_PTR(&mod_rl_bitmask_any_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_all), MP_ROM_PTR(&mod_rl_bitmask_all_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_copy), MP_ROM_PTR(&mod_rl_bitmask_copy_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_to_array), MP_ROM_PTR(&mod_rl_bitmask_to_array_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_flood_fill), MP_ROM_PTR(&mod_rl_bitmask_flood_fill_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mod_rl_bitmask_locals_dict, mod_rl_bitmask_locals_dict_table);
+
+const mp_obj_type_t mp_type_rl_bitmask = {
+	{ &mp_type_type },
+	.name = MP_QSTR_Bitmask,
+	.print = mod_rl_bitmask_print,
+	.make_new = mod_rl_bitmask_make_new,
+	.unary_op = mod_rl_bitmask_unary_op,
+	.binary_op = mod_rl_bitmask_binary_op,
+	.subscr = mod_rl_bitmask_subscr,
+	.locals_dict = (mp_obj_dict_t*)&mod_rl_bitmask_locals_dict,
+};
+
+/************* fused expressions ******************/
+
+typedef struct {
+	mp_obj_base_t base;
+	expr_t* expr;
+} mp_obj_rl_expr_t;
+
+STATIC mp_obj_t mod_rl_expr_wrap(expr_t* expr) {
+	mp_obj_rl_expr_t* output = m_new_obj(mp_obj_rl_expr_t);
+	output->base.type = &mp_type_rl_expr;
+	output->expr = expr;
+	return MP_OBJ_FROM_PTR(output);
+}
+
+// expressions, arrays and numbers can be used as operands, returns NULL otherwise
+STATIC expr_t* mod_rl_expr_operand(mp_obj_t o) {
+	if(mp_obj_is_type(o, &mp_type_rl_expr)) {
+		mp_obj_rl_expr_t* expr = MP_OBJ_TO_PTR(o);
+		return expr->expr;
+	}
+	if(mp_obj_is_type(o, &mp_type_rl_array)) {
+		mp_obj_rl_array_t* array = MP_OBJ_TO_PTR(o);
+		return rl_expr_array(array->array);
+	}
+	if(mp_obj_is_int(o)) return rl_expr_value(mp_obj_get_int(o));
+	if(mp_obj_is_float(o)) return rl_expr_value(mp_obj_get_float(o));
+	return NULL;
+}
+
+STATIC mp_obj_t mod_rl_expr(mp_obj_t operand_in) {
+	expr_t* expr = mod_rl_expr_operand(operand_in);
+	if(expr == NULL) mp_raise_msg(&mp_type_TypeError, "expected array, int or expression");
+	return mod_rl_expr_wrap(expr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_expr_obj, mod_rl_expr);
+
+STATIC void mod_rl_expr_print_node(const mp_print_t *print, expr_t* e) {
+	static const char* operators[] = {"==", ">", "<", ">=", "<=", "!=", "&", "|", "^", "<<", ">>", "+", "-", "*", "/", "%"};
+	static const char* unary_operators[] = {"-", "not ", "~", "abs "};
+	if(e->op == EXPR_ARRAY) {
+		mp_printf(print, "Array[%d, %d]", e->array->width, e->array->height);
+	} else if(e->op == EXPR_VALUE) {
+		mp_printf(print, "%d", e->value);
+	} else if(EXPR_IS_UNARY(e->op)) {
+		mp_printf(print, "(%s", unary_operators[e->op - EXPR_MINUS]);
+		mod_rl_expr_print_node(print, e->left);
+		mp_print_str(print, ")");
+	} else {
+		mp_print_str(print, "(");
+		mod_rl_expr_print_node(print, e->left);
+		mp_printf(print, " %s ", operators[e->op - EXPR_EQUAL]);
+		mod_rl_expr_print_node(print, e->right);
+		mp_print_str(print, ")");
+	}
+}
+
+STATIC void mod_rl_expr_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_t kind) {
+	mp_obj_rl_expr_t *o = MP_OBJ_TO_PTR(o_in);
+	mp_print_str(print, "Expr");
+	mod_rl_expr_print_node(print, o->expr);
+}
+
+STATIC mp_obj_t mod_rl_expr_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(self_in);
+	switch (op) {
+		case MP_UNARY_OP_POSITIVE: return self_in;
+		case MP_UNARY_OP_NEGATIVE: return mod_rl_expr_wrap(rl_expr_unary(EXPR_MINUS, self->expr));
+		case MP_UNARY_OP_INVERT: return mod_rl_expr_wrap(rl_expr_unary(EXPR_INVERT, self->expr));
+		case MP_UNARY_OP_ABS: return mod_rl_expr_wrap(rl_expr_unary(EXPR_ABS, self->expr));
+		default: return MP_OBJ_NULL; // op not supported
+	}
+}
+
+// expressions are immutable, in-place operators build a new node like the regular ones
+#define mod_rl_expr_op(OP, expr_op) \
+	case MP_BINARY_OP_##OP: \
+		return mod_rl_expr_wrap(rl_expr_binary(expr_op, lhs, rhs));
+#define mod_rl_expr_op_inplace(OP, expr_op) \
+	case MP_BINARY_OP_##OP: \
+	case MP_BINARY_OP_INPLACE_##OP: \
+		return mod_rl_expr_wrap(rl_expr_binary(expr_op, lhs, rhs)); \
+	case MP_BINARY_OP_REVERSE_##OP: \
+		return mod_rl_expr_wrap(rl_expr_binary(expr_op, rhs, lhs));
+
+STATIC mp_obj_t mod_rl_expr_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in) {
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(lhs_in);
+	expr_t* lhs = self->expr;
+	expr_t* rhs = mod_rl_expr_operand(rhs_in);
+	if(rhs == NULL) return MP_OBJ_NULL; // op not supported
+	switch (op) {
+		// == and != are available as methods, like for arrays
+		mod_rl_expr_op(MORE, EXPR_GREATER_THAN);
+		mod_rl_expr_op(LESS, EXPR_LESS_THAN);
+		mod_rl_expr_op(MORE_EQUAL, EXPR_GREATER_OR_EQUAL_THAN);
+		mod_rl_expr_op(LESS_EQUAL, EXPR_LESS_OR_EQUAL_THAN);
+		mod_rl_expr_op_inplace(AND, EXPR_AND);
+		mod_rl_expr_op_inplace(OR, EXPR_OR);
+		mod_rl_expr_op_inplace(XOR, EXPR_XOR);
+		mod_rl_expr_op_inplace(LSHIFT, EXPR_LSHIFT);
+		mod_rl_expr_op_inplace(RSHIFT, EXPR_RSHIFT);
+		mod_rl_expr_op_inplace(ADD, EXPR_ADD);
+		mod_rl_expr_op_inplace(SUBTRACT, EXPR_SUB);
+		mod_rl_expr_op_inplace(MULTIPLY, EXPR_MUL);
+		mod_rl_expr_op_inplace(TRUE_DIVIDE, EXPR_DIV);
+		mod_rl_expr_op_inplace(MODULO, EXPR_MOD);
+		default:
+			return MP_OBJ_NULL; // op not supported
+	}
+}
+
+STATIC mp_obj_t mod_rl_expr_equals(mp_obj_t self_in, mp_obj_t other_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_expr));
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(self_in);
+	expr_t* other = mod_rl_expr_operand(other_in);
+	if(other == NULL) mp_raise_msg(&mp_type_TypeError, "expected array, int or expression");
+	return mod_rl_expr_wrap(rl_expr_binary(EXPR_EQUAL, self->expr, other));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_expr_equals_obj, mod_rl_expr_equals);
+
+STATIC mp_obj_t mod_rl_expr_not_equals(mp_obj_t self_in, mp_obj_t other_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_expr));
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(self_in);
+	expr_t* other = mod_rl_expr_operand(other_in);
+	if(other == NULL) mp_raise_msg(&mp_type_TypeError, "expected array, int or expression");
+	return mod_rl_expr_wrap(rl_expr_binary(EXPR_NOT_EQUAL, self->expr, other));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_rl_expr_not_equals_obj, mod_rl_expr_not_equals);
+
+STATIC mp_obj_t mod_rl_expr_logical_not(mp_obj_t self_in) {
+	mp_check_self(mp_obj_is_type(self_in, &mp_type_rl_expr));
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(self_in);
+	return mod_rl_expr_wrap(rl_expr_unary(EXPR_NOT, self->expr));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_expr_logical_not_obj, mod_rl_expr_logical_not);
+
+STATIC mp_obj_t mod_rl_expr_eval(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_self, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_out, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+	};
+	struct {
+		mp_arg_val_t self, out;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_check_self(mp_obj_is_type(args.self.u_obj, &mp_type_rl_expr));
+	mp_obj_rl_expr_t *self = MP_OBJ_TO_PTR(args.self.u_obj);
+	if(args.out.u_obj != mp_const_none) {
+		if(!mp_obj_is_type(args.out.u_obj, &mp_type_rl_array))
+			mp_raise_msg(&mp_type_TypeError, "out should be of type array");
+		mp_obj_rl_array_t *out = MP_OBJ_TO_PTR(args.out.u_obj);
+		rl_expr_eval_into(self->expr, out->array);
+		return args.out.u_obj;
+	}
+	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+	output->base.type = &mp_type_rl_array;
+	output->array = rl_expr_eval(self->expr);
+	return MP_OBJ_FROM_PTR(output);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_rl_expr_eval_obj, 1, mod_rl_expr_eval);
+
+STATIC const mp_rom_map_elem_t mod_rl_expr_locals_dict_table[] = {
+	{ MP_ROM_QSTR(MP_QSTR_equals), MP_ROM_PTR(&mod_rl_expr_equals_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_not_equals), MP_ROM_PTR(&mod_rl_expr_not_equals_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_logical_not), MP_ROM_PTR(&mod_rl_expr_logical_not_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_eval), MP_ROM_PTR(&mod_rl_expr_eval_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mod_rl_expr_locals_dict, mod_rl_expr_locals_dict_table);
+
+const mp_obj_type_t mp_type_rl_expr = {
+	{ &mp_type_type },
+	.name = MP_QSTR_Expr,
+	.print = mod_rl_expr_print,
+	.unary_op = mod_rl_expr_unary_op,
+	.binary_op = mod_rl_expr_binary_op,
+	.locals_dict = (mp_obj_dict_t*)&mod_rl_expr_locals_dict,
+};
+
 /************* rogue_display ******************/
 
-STATIC mp_obj_t mod_td_init_display(mp_obj_t title_in, mp_obj_t width_in, mp_obj_t height_in) {
+STATIC mp_obj_t mod_td_init_display(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_title, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL} },
+		{ MP_QSTR_width, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_height, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_headless, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_false_obj)} },
+	};
+	struct {
+		mp_arg_val_t title, width, height, headless;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
 	size_t len;
-	const char *title = mp_obj_str_get_data(title_in, &len);
-	mp_int_t width = mp_obj_get_int(width_in);
-	mp_int_t height = mp_obj_get_int(height_in);
-	mp_int_t result = td_init_display(title, width, height);
+	const char *title = mp_obj_str_get_data(args.title.u_obj, &len);
+	if(mp_obj_is_true(args.headless.u_obj)) td_set_headless(1);
+	mp_int_t result = td_init_display(title, args.width.u_int, args.height.u_int);
 	return mp_obj_new_bool(result);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_3(mod_td_init_display_obj, mod_td_init_display);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_td_init_display_obj, 3, mod_td_init_display);
+
+// returns a malloc'ed copy of the colors of a palette, or NULL when palette is None
+// the copy is on the gc heap so that it is not leaked when reading the items or drawing raises
+STATIC uint32_t* mod_td_get_palette(mp_obj_t palette_in, int* palette_size) {
+	*palette_size = 0;
+	if(palette_in == mp_const_none) return NULL;
+	int size = mp_obj_get_int(mp_obj_len(palette_in));
+	uint32_t* palette = m_new(uint32_t, size);
+	mp_obj_t iterable = mp_getiter(palette_in, NULL);
+	mp_obj_t item;
+	int i = 0;
+	while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION && i < size) {
+		palette[i++] = mp_obj_get_int(item);
+	}
+	*palette_size = i;
+	return palette;
+}
 
 STATIC mp_obj_t mod_td_array_to_image(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 	static const mp_arg_t allowed_args[] = {
@@ -1055,27 +2258,45 @@ STATIC mp_obj_t mod_td_array_to_image(size_t n_args, const mp_obj_t *pos_args, m
 	mp_obj_rl_array_t *array = MP_OBJ_TO_PTR(args.array.u_obj);
 	mp_int_t tile_width = args.tile_width.u_int;
 	mp_int_t tile_height = args.tile_height.u_int;
-	mp_int_t palette_size = 0;
-	uint32_t* palette = NULL;
-	if(args.palette.u_obj != mp_const_none) {
-		palette_size = mp_obj_get_int(mp_obj_len(args.palette.u_obj));
-		palette = malloc(palette_size * sizeof(uint32_t));
-		mp_obj_t iterable = mp_getiter(args.palette.u_obj, NULL);
-		mp_obj_t item;
-		int i = 0;
-		while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
-			palette[i++] = mp_obj_get_int(item);
-		}
-	}
+	int palette_size = 0;
+	uint32_t* palette = mod_td_get_palette(args.palette.u_obj, &palette_size);
 
 	mp_obj_rl_image_t* output = m_new_obj_with_finaliser(mp_obj_rl_image_t);
 	output->base.type = &mp_type_rl_image;
 	output->image = td_array_to_image(array->array, tile_width, tile_height, palette_size, palette);
-	if(palette != NULL) free(palette);
+	if(palette != NULL) m_del(uint32_t, palette, palette_size);
 	return MP_OBJ_FROM_PTR(output);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_td_array_to_image_obj, 1, mod_td_array_to_image);
 
+STATIC mp_obj_t mod_td_update_image(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_image, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+		{ MP_QSTR_array, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+		{ MP_QSTR_palette, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_x, MP_ARG_INT, {.u_int = 0} },
+		{ MP_QSTR_y, MP_ARG_INT, {.u_int = 0} },
+	};
+	struct {
+		mp_arg_val_t image, array, palette, x, y;
+	} args;
+
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	mp_obj_rl_image_t *image = MP_OBJ_TO_PTR(args.image.u_obj);
+	if(!mp_obj_is_type(image, &mp_type_rl_image) || image->image == NULL)
+		mp_raise_msg(&mp_type_TypeError, "invalid image");
+	if(!mp_obj_is_type(args.array.u_obj, &mp_type_rl_array))
+		mp_raise_msg(&mp_type_TypeError, "array should be of type array");
+	mp_obj_rl_array_t *array = MP_OBJ_TO_PTR(args.array.u_obj);
+	int palette_size = 0;
+	uint32_t* palette = mod_td_get_palette(args.palette.u_obj, &palette_size);
+	td_update_image(image->image, array->array, args.x.u_int, args.y.u_int, palette_size, palette);
+	if(palette != NULL) m_del(uint32_t, palette, palette_size);
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_td_update_image_obj, 2, mod_td_update_image);
+
 STATIC mp_obj_t mod_td_image_to_array(mp_obj_t image_in) {
 	mp_obj_rl_image_t* image = MP_OBJ_TO_PTR(image_in);
 	if(!mp_obj_is_type(image, &mp_type_rl_image) || image->image == NULL)
@@ -1226,6 +2447,129 @@ mp_obj_t mod_td_draw_array(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_td_draw_array_obj, 3, mod_td_draw_array);
 
+/************* layer **************************/
+
+extern const mp_obj_type_t mp_type_rl_layer;
+
+typedef struct {
+	mp_obj_base_t base;
+	layer_t* layer;
+	mp_obj_t image; // keeps the tile image alive
+} mp_obj_rl_layer_t;
+
+STATIC mp_obj_t mod_rl_layer_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+	(void)type_in;
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_width, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_height, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 0} },
+		{ MP_QSTR_image, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_tile_map, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_fg_palette, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_bg_palette, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_none_obj)} },
+		{ MP_QSTR_packed, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_false_obj)} },
+	};
+	struct {
+		mp_arg_val_t width, height, image, tile_map, fg_palette, bg_palette, packed;
+	} args;
+
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+
+	image_t* tile_image = NULL;
+	if(args.image.u_obj != mp_const_none) {
+		mp_obj_rl_image_t *image = MP_OBJ_TO_PTR(args.image.u_obj);
+		if(!mp_obj_is_type(image, &mp_type_rl_image) || image->image == NULL)
+			mp_raise_msg(&mp_type_TypeError, "invalid image");
+		tile_image = image->image;
+	} else if(args.bg_palette.u_obj == mp_const_none) {
+		mp_raise_msg(&mp_type_ValueError, "layer needs an image or a background palette");
+	}
+	if(args.width.u_int <= 0 || args.height.u_int <= 0)
+		mp_raise_msg(&mp_type_ValueError, "invalid layer size");
+
+	uint32_t tile_mask, fg_mask, bg_mask;
+	if(mp_obj_is_true(args.packed.u_obj)) {
+		tile_mask = 0x0000ffff;
+		fg_mask =   0x00ff0000;
+		bg_mask =   0xff000000;
+	} else {
+		tile_mask = fg_mask = bg_mask = 0xffffffff;
+	}
+
+	int tile_map_size, fg_palette_size, bg_palette_size;
+	uint32_t* tile_map = mod_td_get_palette(args.tile_map.u_obj, &tile_map_size);
+	uint32_t* fg_palette = mod_td_get_palette(args.fg_palette.u_obj, &fg_palette_size);
+	uint32_t* bg_palette = mod_td_get_palette(args.bg_palette.u_obj, &bg_palette_size);
+
+	mp_obj_rl_layer_t* output = m_new_obj_with_finaliser(mp_obj_rl_layer_t);
+	output->base.type = &mp_type_rl_layer;
+	output->image = args.image.u_obj;
+	output->layer = td_layer_new(args.width.u_int, args.height.u_int, tile_image, 
+			(int*) tile_map, tile_map_size, tile_mask, 
+			fg_palette, fg_palette_size, fg_mask, 
+			bg_palette, bg_palette_size, bg_mask);
+
+	// the layer keeps its own copies
+	if(tile_map != NULL) m_del(uint32_t, tile_map, tile_map_size);
+	if(fg_palette != NULL) m_del(uint32_t, fg_palette, fg_palette_size);
+	if(bg_palette != NULL) m_del(uint32_t, bg_palette, bg_palette_size);
+	return MP_OBJ_FROM_PTR(output);
+}
+
+STATIC mp_obj_t mod_rl_layer_free(mp_obj_t self_in) {
+	mp_obj_rl_layer_t *self = MP_OBJ_TO_PTR(self_in);
+	if(self->layer != NULL) td_free_layer(self->layer);
+	self->layer = NULL;
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_layer_free_obj, mod_rl_layer_free);
+
+STATIC mp_obj_t mod_rl_layer_draw(size_t n_args, const mp_obj_t *args) {
+	mp_obj_rl_layer_t *self = MP_OBJ_TO_PTR(args[0]);
+	if(!mp_obj_is_type(args[1], &mp_type_rl_array))
+		mp_raise_msg(&mp_type_TypeError, "array should be of type array");
+	mp_obj_rl_array_t *array = MP_OBJ_TO_PTR(args[1]);
+	mp_int_t x = 0, y = 0;
+	if(n_args > 2) x = mp_obj_get_int(args[2]);
+	if(n_args > 3) y = mp_obj_get_int(args[3]);
+	td_draw_layer(self->layer, array->array, x, y);
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_layer_draw_obj, 2, 4, mod_rl_layer_draw);
+
+STATIC mp_obj_t mod_rl_layer_invalidate(mp_obj_t self_in) {
+	mp_obj_rl_layer_t *self = MP_OBJ_TO_PTR(self_in);
+	td_invalidate_layer(self->layer);
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_layer_invalidate_obj, mod_rl_layer_invalidate);
+
+STATIC void mod_rl_layer_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+	mp_obj_rl_layer_t *self = MP_OBJ_TO_PTR(self_in);
+	if(self->layer == NULL) return;
+	if(dest[0] != MP_OBJ_NULL) return; // read-only
+	if (attr == MP_QSTR_width) {
+		dest[0] = mp_obj_new_int(self->layer->width);
+	} else if (attr == MP_QSTR_height) {
+		dest[0] = mp_obj_new_int(self->layer->height);
+	} else if (attr == MP_QSTR_draw) {
+		dest[0] = MP_OBJ_FROM_PTR(&mod_rl_layer_draw_obj);
+		dest[1] = self_in;
+	} else if (attr == MP_QSTR_invalidate) {
+		dest[0] = MP_OBJ_FROM_PTR(&mod_rl_layer_invalidate_obj);
+		dest[1] = self_in;
+	} else if(attr == MP_QSTR___del__) { // method
+		dest[0] = MP_OBJ_FROM_PTR(&mod_rl_layer_free_obj);
+		dest[1] = self_in;
+	}
+}
+
+const mp_obj_type_t mp_type_rl_layer = {
+	{ &mp_type_type },
+	.name = MP_QSTR_Layer,
+	.make_new = mod_rl_layer_make_new,
+	.attr = mod_rl_layer_attr,
+};
+
 mp_obj_t mod_td_draw_text(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 	static const mp_arg_t allowed_args[] = {
 		{ MP_QSTR_font, MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
@@ -1325,12 +2669,40 @@ STATIC mp_obj_t mod_td_clear() {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_td_clear_obj, mod_td_clear);
 
+STATIC mp_obj_t mod_td_screen_to_array() {
+	mp_obj_rl_array_t* output = m_new_obj(mp_obj_rl_array_t);
+	output->base.type = &mp_type_rl_array;
+	output->array = td_screen_to_array();
+	return MP_OBJ_FROM_PTR(output);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_td_screen_to_array_obj, mod_td_screen_to_array);
+
 STATIC mp_obj_t mod_td_quit() {
 	td_quit();
 	return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_td_quit_obj, mod_td_quit);
 
+STATIC mp_obj_t mod_td_set_fps(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	static const mp_arg_t allowed_args[] = {
+		{ MP_QSTR_fps, MP_ARG_INT | MP_ARG_REQUIRED, {.u_int = 60} },
+		{ MP_QSTR_vsync, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_PTR(&mp_const_true_obj)} },
+	};
+	struct {
+		mp_arg_val_t fps, vsync;
+	} args;
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
+	if(args.fps.u_int < 0) mp_raise_msg(&mp_type_ValueError, "fps must be positive or zero");
+	td_set_fps(args.fps.u_int, mp_obj_is_true(args.vsync.u_obj));
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_td_set_fps_obj, 1, mod_td_set_fps);
+
+STATIC mp_obj_t mod_td_frame_time() {
+	return mp_obj_new_float(td_frame_time());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_td_frame_time_obj, mod_td_frame_time);
+
 STATIC mp_obj_t mod_td_random_color() {
 	uint32_t result = td_random_color();
 	return mp_obj_new_int(result);
@@ -1504,6 +2876,25 @@ STATIC mp_obj_t mod_rl_walk_line_next() {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_rl_walk_line_next_obj, mod_rl_walk_line_next);
 
+STATIC mp_obj_t mod_rl_line(size_t n_args, const mp_obj_t *args) {
+	int segment[4];
+	for(int i = 0; i < 4; i++) segment[i] = mp_obj_get_int(args[i]);
+	uint32_t num_points = rl_rasterize_lines(segment, 1, NULL, 0, NULL);
+	// on the gc heap, creating the tuples can raise
+	int* points = m_new(int, 2 * num_points);
+	rl_rasterize_lines(segment, 1, points, num_points, NULL);
+	mp_obj_tuple_t *result = MP_OBJ_TO_PTR(mp_obj_new_tuple(num_points, NULL));
+	for(uint32_t i = 0; i < num_points; i++) {
+		mp_obj_tuple_t *tuple = MP_OBJ_TO_PTR(mp_obj_new_tuple(2, NULL));
+		tuple->items[0] = mp_obj_new_int(points[2 * i]);
+		tuple->items[1] = mp_obj_new_int(points[2 * i + 1]);
+		result->items[i] = tuple;
+	}
+	m_del(int, points, 2 * num_points);
+	return result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_line_obj, 4, 4, mod_rl_line);
+
 STATIC mp_obj_t mod_rl_distance(size_t n_args, const mp_obj_t *args) {
 	mp_float_t x1 = mp_obj_get_float(args[0]);
 	mp_float_t y1 = mp_obj_get_float(args[1]);
@@ -1514,6 +2905,17 @@ STATIC mp_obj_t mod_rl_distance(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_rl_distance_obj, 4, 4, mod_rl_distance);
 
+STATIC mp_obj_t mod_rl_set_thread_count(mp_obj_t count_in) {
+	rl_set_thread_count(mp_obj_get_int(count_in));
+	return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_rl_set_thread_count_obj, mod_rl_set_thread_count);
+
+STATIC mp_obj_t mod_rl_get_thread_count() {
+	return mp_obj_new_int(rl_get_thread_count());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_rl_get_thread_count_obj, mod_rl_get_thread_count);
+
 // WARNING: declaring const long intenger requires to use of MICROPY_LONGINT_IMPL_LONGLONG
 
 const mp_obj_int_t mod_rl_INT_MAX = {{&mp_type_int}, INT_MAX};
@@ -1804,13 +3206,33 @@ STATIC const mp_rom_map_elem_t mp_module_rl_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_Font), MP_ROM_PTR(&mp_type_rl_font) },
 	/************* image ********************/
 	{ MP_ROM_QSTR(MP_QSTR_Image), MP_ROM_PTR(&mp_type_rl_image) },
+	{ MP_ROM_QSTR(MP_QSTR_Layer), MP_ROM_PTR(&mp_type_rl_layer) },
 	/************* rogue_array ********************/
 	{ MP_ROM_QSTR(MP_QSTR_Array), MP_ROM_PTR(&mp_type_rl_array) },
 	{ MP_ROM_QSTR(MP_QSTR_array_from_string), MP_ROM_PTR(&mod_rl_array_from_string_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_array_from_list), MP_ROM_PTR(&mod_rl_array_from_list_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_array_from_bytes), MP_ROM_PTR(&mod_rl_array_from_bytes_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_serialize_arrays), MP_ROM_PTR(&mod_rl_serialize_arrays_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_deserialize_arrays), MP_ROM_PTR(&mod_rl_deserialize_arrays_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_save_arrays), MP_ROM_PTR(&mod_rl_save_arrays_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_load_arrays), MP_ROM_PTR(&mod_rl_load_arrays_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_DistanceMap), MP_ROM_PTR(&mp_type_rl_distance_map) },
+	{ MP_ROM_QSTR(MP_QSTR_Bitmask), MP_ROM_PTR(&mp_type_rl_bitmask) },
+	{ MP_ROM_QSTR(MP_QSTR_bitmask_from_array), MP_ROM_PTR(&mod_rl_bitmask_from_array_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_expr), MP_ROM_PTR(&mod_rl_expr_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_FOV_RAYCAST), MP_ROM_INT(FOV_RAYCAST) },
+	{ MP_ROM_QSTR(MP_QSTR_FOV_SHADOWCAST), MP_ROM_INT(FOV_SHADOWCAST) },
+	{ MP_ROM_QSTR(MP_QSTR_DISTANCE_EUCLIDEAN), MP_ROM_INT(DISTANCE_EUCLIDEAN) },
+	{ MP_ROM_QSTR(MP_QSTR_DISTANCE_CHEBYSHEV), MP_ROM_INT(DISTANCE_CHEBYSHEV) },
+	{ MP_ROM_QSTR(MP_QSTR_DISTANCE_MANHATTAN), MP_ROM_INT(DISTANCE_MANHATTAN) },
+	{ MP_ROM_QSTR(MP_QSTR_INT32), MP_ROM_INT(DTYPE_INT32) },
+	{ MP_ROM_QSTR(MP_QSTR_UINT8), MP_ROM_INT(DTYPE_UINT8) },
+	{ MP_ROM_QSTR(MP_QSTR_INT16), MP_ROM_INT(DTYPE_INT16) },
+	{ MP_ROM_QSTR(MP_QSTR_FLOAT32), MP_ROM_INT(DTYPE_FLOAT32) },
 	/************* rogue_display ******************/
 	{ MP_ROM_QSTR(MP_QSTR_init_display), MP_ROM_PTR(&mod_td_init_display_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_array_to_image), MP_ROM_PTR(&mod_td_array_to_image_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_update_image), MP_ROM_PTR(&mod_td_update_image_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_image_to_array), MP_ROM_PTR(&mod_td_image_to_array_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_draw_image), MP_ROM_PTR(&mod_td_draw_image_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_draw_tile), MP_ROM_PTR(&mod_td_draw_tile_obj) },
@@ -1823,7 +3245,10 @@ STATIC const mp_rom_map_elem_t mp_module_rl_globals_table[] = {
 	{ MP_ROM_QSTR(MP_QSTR_draw_rect), MP_ROM_PTR(&mod_td_draw_rect_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_draw_line), MP_ROM_PTR(&mod_td_draw_line_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_clear), MP_ROM_PTR(&mod_td_clear_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_screen_to_array), MP_ROM_PTR(&mod_td_screen_to_array_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_quit), MP_ROM_PTR(&mod_td_quit_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_set_fps), MP_ROM_PTR(&mod_td_set_fps_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_frame_time), MP_ROM_PTR(&mod_td_frame_time_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_color), MP_ROM_PTR(&mod_td_color_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_hsv_color), MP_ROM_PTR(&mod_td_hsv_color_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_color_components), MP_ROM_PTR(&mod_td_color_components_obj) },
@@ -1842,7 +3267,10 @@ STATIC const mp_rom_map_elem_t mp_module_rl_globals_table[] = {
 	/************** utils ******************/
 	{ MP_ROM_QSTR(MP_QSTR_walk_line_start), MP_ROM_PTR(&mod_rl_walk_line_start_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_walk_line_next), MP_ROM_PTR(&mod_rl_walk_line_next_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_line), MP_ROM_PTR(&mod_rl_line_obj) },
 	{ MP_ROM_QSTR(MP_QSTR_distance), MP_ROM_PTR(&mod_rl_distance_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_set_thread_count), MP_ROM_PTR(&mod_rl_set_thread_count_obj) },
+	{ MP_ROM_QSTR(MP_QSTR_get_thread_count), MP_ROM_PTR(&mod_rl_get_thread_count_obj) },
 	/*************** constants **************/
 	// text alignment
 	{ MP_ROM_QSTR(MP_QSTR_ALIGN_LEFT), MP_ROM_INT(TD_ALIGN_LEFT) },
@@ -281,6 +281,7 @@ MP_NOINLINE void pyrogue_init(const char* resource_path) {
 }
 
 MP_NOINLINE void pyrogue_shutdown() {
+	rl_thread_pool_shutdown();
 	mp_deinit();
 
 #if MICROPY_ENABLE_GC
@@ -288,9 +289,14 @@ MP_NOINLINE void pyrogue_shutdown() {
 #endif
 }
 
-MP_NOINLINE void pyrogue_run_string(const char* name, const char* code) {
+// status of the last script, the value of SystemExit or 1 for other uncaught exceptions
+static int exit_status = 0;
+
+MP_NOINLINE int pyrogue_run_string(const char* name, const char* code) {
 	rl_set_error_handler(error_handler);
-	do_str(code, strlen(code), name);
+	int result = do_str(code, strlen(code), name);
+	exit_status = result & FORCED_EXIT ? result & 255 : result;
+	return exit_status;
 }
 
 MP_NOINLINE int pyrogue_run(const char* filename) {
@@ -357,7 +363,7 @@ MP_NOINLINE int cmdline_main(int argc, char** argv) {
 
 	pyrogue_shutdown();
 
-	return 0;
+	return exit_status;
 }
 
 // support importing from assets